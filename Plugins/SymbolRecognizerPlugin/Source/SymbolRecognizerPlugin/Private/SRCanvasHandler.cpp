@@ -138,6 +138,7 @@ void USRCanvasHandler::ClearCanvas()
 {
 	BrushPosition = FVector2D::ZeroVector;//??
 	DrawLines.Empty();
+	DrawRevision++;
 	ResetMaxima();
 	ScaledSymbolSize = FVector2D(1, 1);
 	UpdateTexture();
@@ -228,6 +229,7 @@ bool USRCanvasHandler::Draw(bool bAddNewStartPoint,const FVector2D& InPosition)
 		DrawLines.Last().Points.Emplace(InPosition);
 	}
 
+	DrawRevision++;
 	UpdateBrushPositionAndMaxima(InPosition);
 	UpdateTexture();
 
@@ -0,0 +1,112 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#include "SRIncrementalQuery.h"
+#include "SymbolRecognizerPlugin.h"
+
+
+void FSRIncrementalQuery::Reset(const FSRNeuralNetwork* InNetwork, const FSRDMatrix* InOutputLayer)
+{
+	Network = InNetwork;
+	OutputLayer = InOutputLayer;
+	bHasState = false;
+	WeightsByInput.Reset();
+	PreviousInput.Reset();
+	HiddenSums.Reset();
+	HiddenOutputs.Reset();
+
+	if (!IsValid())
+	{
+		return;
+	}
+
+	const uint32 InputNodes = Network->InputNodes;
+	const uint32 HiddenNodes = Network->HiddenNodes;
+	WeightsByInput.SetNumUninitialized(InputNodes * HiddenNodes);
+	for (uint32 Row = 0; Row < HiddenNodes; ++Row)
+	{
+		const float* Weights = Network->wih.R[Row].C.GetData();
+		for (uint32 Col = 0; Col < InputNodes; ++Col)
+		{
+			WeightsByInput[Col * HiddenNodes + Row] = Weights[Col];
+		}
+	}
+}
+
+FSRDMatrix FSRIncrementalQuery::Update(const TArray<float>& InInputList, const TBitArray<>* AllowedOutputs)
+{
+	if (!IsValid() || (uint32)InInputList.Num() != Network->InputNodes)
+	{
+		return FSRDMatrix(Network ? Network->OutputNodes : 0, 1, 0.0f);
+	}
+
+	const int32 InputNodes = Network->InputNodes;
+	const int32 HiddenNodes = Network->HiddenNodes;
+
+	if (!bHasState || UpdatesSinceRefresh >= RefreshInterval)
+	{
+		FullRecompute(InInputList);
+	}
+	else
+	{
+		LastChangedInputs = 0;
+		for (int32 Col = 0; Col < InputNodes; ++Col)
+		{
+			LastChangedInputs += (InInputList[Col] != PreviousInput[Col]) ? 1 : 0;
+		}
+
+		if (LastChangedInputs > InputNodes * MaxChangedInputsRatio)
+		{
+			FullRecompute(InInputList);
+		}
+		else if (LastChangedInputs > 0)
+		{
+			float* Sums = HiddenSums.GetData();
+			for (int32 Col = 0; Col < InputNodes; ++Col)
+			{
+				const float Delta = InInputList[Col] - PreviousInput[Col];
+				if (Delta != 0.0f)
+				{
+					const float* Weights = WeightsByInput.GetData() + Col * HiddenNodes;
+					for (int32 Row = 0; Row < HiddenNodes; ++Row)
+					{
+						Sums[Row] += Delta * Weights[Row];
+					}
+					PreviousInput[Col] = InInputList[Col];
+				}
+			}
+			UpdatesSinceRefresh++;
+		}
+	}
+
+	HiddenOutputs.SetNumUninitialized(HiddenNodes);
+	for (int32 Row = 0; Row < HiddenNodes; ++Row)
+	{
+		HiddenOutputs[Row] = FSRNeuralNetwork::Activate(HiddenSums[Row], Network->HiddenActivation);
+	}
+
+	return OutputLayer ? Network->QueryOutputLayer(*OutputLayer, HiddenOutputs.GetData(), AllowedOutputs) : Network->QueryFromHidden(HiddenOutputs.GetData(), AllowedOutputs);
+}
+
+void FSRIncrementalQuery::FullRecompute(const TArray<float>& InInputList)
+{
+	const uint32 InputNodes = Network->InputNodes;
+	const uint32 HiddenNodes = Network->HiddenNodes;
+
+	//sums accumulated from 0 in column order like FSRDMatrix::operator*
+	HiddenSums.SetNumUninitialized(HiddenNodes);
+	for (uint32 Row = 0; Row < HiddenNodes; ++Row)
+	{
+		const float* Weights = Network->wih.R[Row].C.GetData();
+		float Sum = 0;
+		for (uint32 Col = 0; Col < InputNodes; ++Col)
+		{
+			Sum += Weights[Col] * InInputList[Col];
+		}
+		HiddenSums[Row] = Sum;
+	}
+
+	PreviousInput = InInputList;
+	LastChangedInputs = InputNodes;
+	UpdatesSinceRefresh = 0;
+	bHasState = true;
+}
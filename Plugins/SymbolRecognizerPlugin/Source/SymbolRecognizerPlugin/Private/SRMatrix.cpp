@@ -317,6 +317,34 @@ FSRDMatrix FSRDMatrix::ActivationOperation(EActivationFunc InActivationFunc)
 	return Mat;
 }
 
+FSRDMatrix FSRDMatrix::ActivationDerivativeOperation(EActivationFunc InActivationFunc)
+{
+	FSRDMatrix Mat = FSRDMatrix(NumRows, NumColumns);
+
+	float(FSRDMatrix::*DerivativeFN)(const float&)const = nullptr;
+	switch (InActivationFunc)
+	{
+	case FSRDMatrix::Sigmoid:
+		DerivativeFN = &FSRDMatrix::SigmoidDerivativeFunc;
+		break;
+	case FSRDMatrix::ReLU:
+		DerivativeFN = &FSRDMatrix::ReLUDerivativeFunc;
+		break;
+	case FSRDMatrix::TanH:
+		DerivativeFN = &FSRDMatrix::TanHDerivativeFunc;
+		break;
+	}
+	for (uint32 r = 0; r < NumRows; r++)
+	{
+		for (uint32 c = 0; c < NumColumns; c++)
+		{
+			Mat.R[r].C[c] = (this->*DerivativeFN)(R[r].C[c]);
+		}
+	}
+
+	return Mat;
+}
+
 FSRDMatrix FSRDMatrix::ToSoftMax()
 {
 	double ExpSum = 0;
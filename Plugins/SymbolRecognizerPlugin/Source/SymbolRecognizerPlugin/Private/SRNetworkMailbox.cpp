@@ -0,0 +1,26 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#include "SRNetworkMailbox.h"
+
+FSRNetworkMailbox::~FSRNetworkMailbox()
+{
+	delete Pending;
+}
+
+void FSRNetworkMailbox::Publish(const FSRNeuralNetwork& InNetwork)
+{
+	//copy is made before the swap, consumer never sees a network being written.
+	FSRNeuralNetwork* Published = new FSRNeuralNetwork(InNetwork);
+	FSRNeuralNetwork* Replaced = (FSRNeuralNetwork*)FPlatformAtomics::InterlockedExchangePtr((void**)&Pending, Published);
+	delete Replaced;
+}
+
+TUniquePtr<FSRNeuralNetwork> FSRNetworkMailbox::Consume()
+{
+	if (Pending == nullptr)
+	{
+		return nullptr;
+	}
+
+	return TUniquePtr<FSRNeuralNetwork>((FSRNeuralNetwork*)FPlatformAtomics::InterlockedExchangePtr((void**)&Pending, nullptr));
+}
@@ -2,32 +2,232 @@
 
 #include "SRNeuralNetwork.h"
 #include "SymbolRecognizerPlugin.h"
+#include "Math/RandomStream.h"
 
+static FMatrixOperationDelegate SRInitialWeight(FRandomStream& InRandom)
+{
+	return FMatrixOperationDelegate::CreateLambda([&InRandom]() { return InRandom.FRand() * 0.01f + 0.001f; });
+}
 
-FSRNeuralNetwork::FSRNeuralNetwork(uint32 InInputNodes, uint32 InHiddenNodes, uint32 InOutputNodes, float InLearningRate)
+FSRNeuralNetwork::FSRNeuralNetwork(uint32 InInputNodes, uint32 InHiddenNodes, uint32 InOutputNodes, float InLearningRate, ESRActivationFunc InHiddenActivation, ESRActivationFunc InOutputActivation, int32 InRandomSeed)
 {
 	InputNodes = InInputNodes;
 	HiddenNodes = InHiddenNodes;
 	OutputNodes = InOutputNodes;
 	LearningRate = InLearningRate;
-	wih = FSRDMatrix(HiddenNodes, InputNodes, FMatrixOperationDelegate::CreateLambda([&]() {return FMath::FRand() * 0.01f + 0.001f; }));
-	who = FSRDMatrix(OutputNodes, HiddenNodes, FMatrixOperationDelegate::CreateLambda([&]() {return FMath::FRand() * 0.01f + 0.001f; }));
+	HiddenActivation = InHiddenActivation;
+	OutputActivation = InOutputActivation;
+	RandomSeed = InRandomSeed;
+	FRandomStream Random(RandomSeed);
+	wih = FSRDMatrix(HiddenNodes, InputNodes, SRInitialWeight(Random));
+	who = FSRDMatrix(OutputNodes, HiddenNodes, SRInitialWeight(Random));
+}
+
+void FSRNeuralNetwork::InitializeGroups(uint32 InGroupSize)
+{
+	GroupSize = InGroupSize;
+	GroupHeads.Empty();
+
+	//output layer only, wih keeps its weights.
+	FRandomStream Random((int32)HashCombine(GetTypeHash(RandomSeed), GetTypeHash(InGroupSize)));
+	if (GroupSize == 0 || GroupSize >= OutputNodes)
+	{
+		GroupSize = 0;
+		who = FSRDMatrix(OutputNodes, HiddenNodes, SRInitialWeight(Random));
+		return;
+	}
+
+	const uint32 GroupsCount = GetGroupsCount();
+	who = FSRDMatrix(GroupsCount, HiddenNodes, SRInitialWeight(Random));
+	for (uint32 Group = 0; Group < GroupsCount; ++Group)
+	{
+		const uint32 GroupSymbols = FMath::Min(GroupSize, OutputNodes - Group * GroupSize);
+		GroupHeads.Emplace(FSRDMatrix(GroupSymbols, HiddenNodes, SRInitialWeight(Random)));
+	}
+}
+
+FSRNeuralNetwork FSRNeuralNetwork::MakeUntrained(uint32 InHiddenNodes) const
+{
+	FSRNeuralNetwork Network(InputNodes, InHiddenNodes, OutputNodes, LearningRate, HiddenActivation, OutputActivation, RandomSeed);
+	Network.InputEncoding = InputEncoding;
+	if (GroupSize > 0)
+	{
+		Network.InitializeGroups(GroupSize);
+	}
+	return Network;
+}
+
+int64 FSRNeuralNetwork::GetInferenceFlops() const
+{
+	const int64 OutputRows = GroupSize > 0 ? GetGroupsCount() + GroupSize : OutputNodes;
+	return 2 * ((int64)InputNodes * HiddenNodes + (int64)HiddenNodes * OutputRows);
+}
+
+uint32 FSRNeuralNetwork::GetWeightsCrc() const
+{
+	uint32 Crc = 0;
+	auto AddMatrix = [&Crc](const FSRDMatrix& InMatrix)
+	{
+		for (const FSRRowItem& Row : InMatrix.R)
+			Crc = FCrc::MemCrc32(Row.C.GetData(), Row.C.Num() * sizeof(float), Crc);
+	};
+
+	AddMatrix(wih);
+	AddMatrix(who);
+	for (const FSRDMatrix& GroupHead : GroupHeads)
+		AddMatrix(GroupHead);
+	return Crc;
+}
+
+FSRNeuralNetwork FSRNeuralNetwork::MakePruned(uint32 InKeepHiddenNodes) const
+{
+	if (!bIsTrained || IsHierarchical() || InKeepHiddenNodes == 0 || InKeepHiddenNodes >= HiddenNodes)
+	{
+		return FSRNeuralNetwork();
+	}
+
+	//importance of hidden node: magnitude of incoming weights times magnitude of outgoing weights.
+	TArray<TPair<float, uint32>> Importance;
+	Importance.Reserve(HiddenNodes);
+	for (uint32 Hidden = 0; Hidden < HiddenNodes; ++Hidden)
+	{
+		float InNorm = 0;
+		for (float Weight : wih.R[Hidden].C)
+		{
+			InNorm += Weight * Weight;
+		}
+
+		float OutNorm = 0;
+		for (uint32 Row = 0; Row < OutputNodes; ++Row)
+		{
+			OutNorm += who.R[Row].C[Hidden] * who.R[Row].C[Hidden];
+		}
+
+		Importance.Emplace(FMath::Sqrt(InNorm * OutNorm), Hidden);
+	}
+
+	Importance.Sort([](const TPair<float, uint32>& A, const TPair<float, uint32>& B) { return A.Key > B.Key; });
+	TArray<uint32> KeptNodes;
+	for (uint32 Idx = 0; Idx < InKeepHiddenNodes; ++Idx)
+	{
+		KeptNodes.Add(Importance[Idx].Value);
+	}
+	//keep original order of nodes.
+	KeptNodes.Sort();
+
+	FSRNeuralNetwork Network = *this;
+	Network.HiddenNodes = InKeepHiddenNodes;
+	Network.SharedTrunk = NAME_None;
+	Network.wih = FSRDMatrix(InKeepHiddenNodes, InputNodes, 0.0f);
+	Network.who = FSRDMatrix(OutputNodes, InKeepHiddenNodes, 0.0f);
+	for (uint32 Idx = 0; Idx < InKeepHiddenNodes; ++Idx)
+	{
+		Network.wih.R[Idx].C = wih.R[KeptNodes[Idx]].C;
+		for (uint32 Row = 0; Row < OutputNodes; ++Row)
+		{
+			Network.who.R[Row].C[Idx] = who.R[Row].C[KeptNodes[Idx]];
+		}
+	}
+
+	return Network;
+}
+
+void FSRNeuralNetwork::ForwardHidden(const float* Inputs, TArray<float, TInlineAllocator<128>>& OutHiddenOutputs) const
+{
+	//sums accumulated from 0 in column order like FSRDMatrix::operator*
+	OutHiddenOutputs.SetNumUninitialized(HiddenNodes);
+	for (uint32 Row = 0; Row < HiddenNodes; ++Row)
+	{
+		const float* Weights = wih.R[Row].C.GetData();
+		float Sum = 0;
+		for (uint32 Col = 0; Col < InputNodes; ++Col)
+		{
+			Sum += Weights[Col] * Inputs[Col];
+		}
+		OutHiddenOutputs[Row] = Activate(Sum, HiddenActivation);
+	}
 }
 
 void FSRNeuralNetwork::Train(const TArray<float>& InputList, const TArray<float>& OutputList)
+{
+	if (IsHierarchical())
+	{
+		TrainHierarchical(InputList, OutputList);
+		return;
+	}
+
+	if ((uint32)InputList.Num() != InputNodes || (uint32)OutputList.Num() != OutputNodes
+		|| (uint32)wih.R.Num() != HiddenNodes || (uint32)who.R.Num() != OutputNodes)
+	{
+		TrainMatrix(InputList, OutputList);
+		return;
+	}
+
+	const float* Inputs = InputList.GetData();
+	const float* Targets = OutputList.GetData();
+
+	TArray<float, TInlineAllocator<128>> HiddenOutputs;
+	TArray<float, TInlineAllocator<128>> HiddenErrors;
+	TArray<float, TInlineAllocator<64>> OutputErrors;
+	TArray<float, TInlineAllocator<64>> OutputGradients;
+	HiddenErrors.SetNumZeroed(HiddenNodes);
+	OutputErrors.SetNumUninitialized(OutputNodes);
+	OutputGradients.SetNumUninitialized(OutputNodes);
+
+	//activation FP
+	ForwardHidden(Inputs, HiddenOutputs);
+
+	for (uint32 Row = 0; Row < OutputNodes; ++Row)
+	{
+		const float* Weights = who.R[Row].C.GetData();
+		float Sum = 0;
+		for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+		{
+			Sum += Weights[Col] * HiddenOutputs[Col];
+		}
+		const float FinalOutput = Activate(Sum, OutputActivation);
+		OutputErrors[Row] = Targets[Row] - FinalOutput;
+		OutputGradients[Row] = GetNodeGradient(OutputErrors[Row], FinalOutput, OutputActivation);
+	}
+
+	//errors BP and who update in one pass: hidden errors have to use who from before the update.
+	for (uint32 Row = 0; Row < OutputNodes; ++Row)
+	{
+		float* Weights = who.R[Row].C.GetData();
+		const float OutputError = OutputErrors[Row];
+		const float Gradient = OutputGradients[Row];
+		for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+		{
+			HiddenErrors[Col] += Weights[Col] * OutputError;
+			Weights[Col] = Weights[Col] + Gradient * HiddenOutputs[Col] * LearningRate;
+		}
+	}
+
+	//update weights from inputs to hidden
+	for (uint32 Row = 0; Row < HiddenNodes; ++Row)
+	{
+		float* Weights = wih.R[Row].C.GetData();
+		const float Gradient = GetNodeGradient(HiddenErrors[Row], HiddenOutputs[Row], HiddenActivation);
+		for (uint32 Col = 0; Col < InputNodes; ++Col)
+		{
+			Weights[Col] = Weights[Col] + Gradient * Inputs[Col] * LearningRate;
+		}
+	}
+
+	bIsTrained = true;
+}
+
+void FSRNeuralNetwork::TrainMatrix(const TArray<float>& InputList, const TArray<float>& OutputList)
 {
 	FSRDMatrix Inputs = FSRDMatrix(InputNodes, 1, InputList);
 	FSRDMatrix Targets = FSRDMatrix(OutputNodes, 1, OutputList);
 
-	FString InputsStr = "Inputs: " + Inputs.ToString();
-	FString TargetsStr = "Targets: " + Targets.ToString();
-
 	//activation FP
 	FSRDMatrix HiddenInputs = wih * Inputs;
-	FSRDMatrix HiddenOutputs = HiddenInputs.ActivationOperation(FSRDMatrix::Sigmoid);
+	FSRDMatrix HiddenOutputs = HiddenInputs.ActivationOperation(ToMatrixActivation(HiddenActivation));
 
 	FSRDMatrix FinalInputs = who * HiddenOutputs;
-	FSRDMatrix FinalOutputs = FinalInputs.ActivationOperation(FSRDMatrix::Sigmoid);
+	FSRDMatrix FinalOutputs = FinalInputs.ActivationOperation(ToMatrixActivation(OutputActivation));
 
 	//errors BP
 	FSRDMatrix OutputErrors = Targets - FinalOutputs;
@@ -35,28 +235,367 @@ void FSRNeuralNetwork::Train(const TArray<float>& InputList, const TArray<float>
 
 	//gradient descent learn
 	//update weights from hidden to outputs
-	who += OutputErrors.CompWiseMultiply(FinalOutputs).CompWiseMultiply(1.0f - FinalOutputs) * HiddenOutputs.GetTranspose() * LearningRate;
+	who += GetLayerGradient(OutputErrors, FinalOutputs, OutputActivation) * HiddenOutputs.GetTranspose() * LearningRate;
 	//update weights from inputs to hidden
-	wih += HiddenErrors.CompWiseMultiply(HiddenOutputs).CompWiseMultiply(1.0f - HiddenOutputs) * Inputs.GetTranspose() * LearningRate;
+	wih += GetLayerGradient(HiddenErrors, HiddenOutputs, HiddenActivation) * Inputs.GetTranspose() * LearningRate;
+
+	bIsTrained = true;
+}
+
+void FSRNeuralNetwork::TrainHierarchical(const TArray<float>& InputList, const TArray<float>& OutputList)
+{
+	if ((uint32)InputList.Num() < InputNodes || (uint32)OutputList.Num() < OutputNodes)
+	{
+		return;
+	}
+
+	//expected symbol is the biggest target, the smallest one is used for all other outputs.
+	uint32 Answer = 0;
+	float TargetOff = OutputList[0];
+	for (uint32 Idx = 1; Idx < OutputNodes; ++Idx)
+	{
+		if (OutputList[Idx] > OutputList[Answer])
+		{
+			Answer = Idx;
+		}
+		TargetOff = FMath::Min(TargetOff, OutputList[Idx]);
+	}
+	const uint32 AnswerGroup = Answer / GroupSize;
+	const float TargetOn = OutputList[Answer];
+
+	const float* Inputs = InputList.GetData();
+	TArray<float, TInlineAllocator<128>> HiddenOutputs;
+	ForwardHidden(Inputs, HiddenOutputs);
+
+	TArray<float, TInlineAllocator<128>> HiddenErrors;
+	HiddenErrors.SetNumZeroed(HiddenNodes);
+
+	//group layer and the head of expected group are trained like regular output layers, both feed errors back to hidden.
+	auto TrainOutputLayer = [&](FSRDMatrix& Layer, uint32 TargetRow)
+	{
+		for (uint32 Row = 0; Row < Layer.NumRows; ++Row)
+		{
+			float* Weights = Layer.R[Row].C.GetData();
+			float Sum = 0;
+			for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+			{
+				Sum += Weights[Col] * HiddenOutputs[Col];
+			}
+
+			const float Output = Activate(Sum, OutputActivation);
+			const float OutputError = ((Row == TargetRow) ? TargetOn : TargetOff) - Output;
+			const float Gradient = GetNodeGradient(OutputError, Output, OutputActivation);
+			for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+			{
+				HiddenErrors[Col] += Weights[Col] * OutputError;
+				Weights[Col] = Weights[Col] + Gradient * HiddenOutputs[Col] * LearningRate;
+			}
+		}
+	};
+
+	TrainOutputLayer(who, AnswerGroup);
+	TrainOutputLayer(GroupHeads[AnswerGroup], Answer - AnswerGroup * GroupSize);
+
+	for (uint32 Row = 0; Row < HiddenNodes; ++Row)
+	{
+		float* Weights = wih.R[Row].C.GetData();
+		const float Gradient = GetNodeGradient(HiddenErrors[Row], HiddenOutputs[Row], HiddenActivation);
+		for (uint32 Col = 0; Col < InputNodes; ++Col)
+		{
+			Weights[Col] = Weights[Col] + Gradient * Inputs[Col] * LearningRate;
+		}
+	}
+
+	bIsTrained = true;
+}
+
+void FSRNeuralNetwork::TrainOutputLayer(const TArray<float>& InputList, const TArray<float>& OutputList)
+{
+	if (IsHierarchical() || (uint32)InputList.Num() != InputNodes || (uint32)OutputList.Num() != OutputNodes
+		|| (uint32)wih.R.Num() != HiddenNodes || (uint32)who.R.Num() != OutputNodes)
+	{
+		return;
+	}
+
+	TArray<float, TInlineAllocator<128>> HiddenOutputs;
+	ForwardHidden(InputList.GetData(), HiddenOutputs);
+
+	for (uint32 Row = 0; Row < OutputNodes; ++Row)
+	{
+		float* Weights = who.R[Row].C.GetData();
+		float Sum = 0;
+		for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+		{
+			Sum += Weights[Col] * HiddenOutputs[Col];
+		}
+
+		const float FinalOutput = Activate(Sum, OutputActivation);
+		const float Gradient = GetNodeGradient(OutputList[Row] - FinalOutput, FinalOutput, OutputActivation);
+		for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+		{
+			Weights[Col] = Weights[Col] + Gradient * HiddenOutputs[Col] * LearningRate;
+		}
+	}
 
 	bIsTrained = true;
 }
 
+void FSRNeuralNetwork::AccumulateGradients(const TArray<float>& InputList, const TArray<float>& OutputList, FSRGradientBuffer& OutGradients, bool bOutputLayerOnly) const
+{
+	if (IsHierarchical() || (uint32)InputList.Num() != InputNodes || (uint32)OutputList.Num() != OutputNodes
+		|| (uint32)OutGradients.wih.Num() != HiddenNodes * InputNodes || (uint32)OutGradients.who.Num() != OutputNodes * HiddenNodes)
+	{
+		return;
+	}
+
+	const float* Inputs = InputList.GetData();
+	const float* Targets = OutputList.GetData();
+
+	TArray<float, TInlineAllocator<128>> HiddenOutputs;
+	TArray<float, TInlineAllocator<128>> HiddenErrors;
+	HiddenErrors.SetNumZeroed(HiddenNodes);
+	ForwardHidden(Inputs, HiddenOutputs);
+
+	for (uint32 Row = 0; Row < OutputNodes; ++Row)
+	{
+		const float* Weights = who.R[Row].C.GetData();
+		float Sum = 0;
+		for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+		{
+			Sum += Weights[Col] * HiddenOutputs[Col];
+		}
+
+		const float FinalOutput = Activate(Sum, OutputActivation);
+		const float OutputError = Targets[Row] - FinalOutput;
+		const float Gradient = GetNodeGradient(OutputError, FinalOutput, OutputActivation);
+		float* Deltas = OutGradients.who.GetData() + Row * HiddenNodes;
+		for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+		{
+			HiddenErrors[Col] += Weights[Col] * OutputError;
+			Deltas[Col] += Gradient * HiddenOutputs[Col];
+		}
+	}
+
+	if (!bOutputLayerOnly)
+	{
+		for (uint32 Row = 0; Row < HiddenNodes; ++Row)
+		{
+			const float Gradient = GetNodeGradient(HiddenErrors[Row], HiddenOutputs[Row], HiddenActivation);
+			float* Deltas = OutGradients.wih.GetData() + Row * InputNodes;
+			for (uint32 Col = 0; Col < InputNodes; ++Col)
+			{
+				Deltas[Col] += Gradient * Inputs[Col];
+			}
+		}
+	}
+
+	OutGradients.SamplesCount++;
+}
+
+void FSRNeuralNetwork::ApplyGradients(const FSRGradientBuffer& InGradients, float InScale, bool bOutputLayerOnly)
+{
+	if ((uint32)InGradients.wih.Num() != HiddenNodes * InputNodes || (uint32)InGradients.who.Num() != OutputNodes * HiddenNodes
+		|| (uint32)who.R.Num() != OutputNodes)
+	{
+		return;
+	}
+
+	for (uint32 Row = 0; Row < OutputNodes; ++Row)
+	{
+		float* Weights = who.R[Row].C.GetData();
+		const float* Deltas = InGradients.who.GetData() + Row * HiddenNodes;
+		for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+		{
+			Weights[Col] += Deltas[Col] * InScale;
+		}
+	}
+
+	if (!bOutputLayerOnly)
+	{
+		for (uint32 Row = 0; Row < HiddenNodes; ++Row)
+		{
+			float* Weights = wih.R[Row].C.GetData();
+			const float* Deltas = InGradients.wih.GetData() + Row * InputNodes;
+			for (uint32 Col = 0; Col < InputNodes; ++Col)
+			{
+				Weights[Col] += Deltas[Col] * InScale;
+			}
+		}
+	}
+
+	bIsTrained = true;
+}
+
+void FSRGradientBuffer::Init(const FSRNeuralNetwork& InNetwork)
+{
+	wih.Init(0.0f, InNetwork.HiddenNodes * InNetwork.InputNodes);
+	who.Init(0.0f, InNetwork.OutputNodes * InNetwork.HiddenNodes);
+	SamplesCount = 0;
+}
+
+void FSRGradientBuffer::Reset()
+{
+	FMemory::Memzero(wih.GetData(), wih.Num() * sizeof(float));
+	FMemory::Memzero(who.GetData(), who.Num() * sizeof(float));
+	SamplesCount = 0;
+}
+
+void FSRGradientBuffer::Add(const FSRGradientBuffer& InOther, int32 InStart, int32 InEnd)
+{
+	check(wih.Num() == InOther.wih.Num() && who.Num() == InOther.who.Num());
+	const int32 WihEnd = FMath::Min(InEnd, wih.Num());
+	for (int32 Idx = InStart; Idx < WihEnd; ++Idx)
+	{
+		wih[Idx] += InOther.wih[Idx];
+	}
+
+	const int32 WhoEnd = FMath::Min(InEnd, Num()) - wih.Num();
+	for (int32 Idx = FMath::Max(InStart - wih.Num(), 0); Idx < WhoEnd; ++Idx)
+	{
+		who[Idx] += InOther.who[Idx];
+	}
+}
+
 FSRDMatrix FSRNeuralNetwork::Query(const TArray<float>& InputList) const
 {
+	if (IsHierarchical())
+	{
+		return Query(InputList, nullptr);
+	}
+
 	FSRDMatrix Inputs = FSRDMatrix(InputNodes, 1, InputList);
 	FSRDMatrix HiddenInputs = wih * Inputs;
-	FSRDMatrix HiddenOutputs = HiddenInputs.ActivationOperation(FSRDMatrix::Sigmoid);
+	FSRDMatrix HiddenOutputs = HiddenInputs.ActivationOperation(ToMatrixActivation(HiddenActivation));
 	FSRDMatrix FinalInputs = who * HiddenOutputs;
-	FSRDMatrix FinalOutputs = FinalInputs.ActivationOperation(FSRDMatrix::Sigmoid);
+	FSRDMatrix FinalOutputs = FinalInputs.ActivationOperation(ToMatrixActivation(OutputActivation));
 
 	return FinalOutputs;
 }
 
+FSRDMatrix FSRNeuralNetwork::Query(const TArray<float>& InputList, const TBitArray<>* AllowedOutputs) const
+{
+	if (AllowedOutputs == nullptr && !IsHierarchical())
+	{
+		return Query(InputList);
+	}
+
+	if ((uint32)InputList.Num() < InputNodes)
+	{
+		return FSRDMatrix(OutputNodes, 1, 0.0f);
+	}
+
+	TArray<float, TInlineAllocator<128>> HiddenOutputs;
+	ForwardHidden(InputList.GetData(), HiddenOutputs);
+	return QueryFromHidden(HiddenOutputs.GetData(), AllowedOutputs);
+}
+
+FSRDMatrix FSRNeuralNetwork::QueryFromHidden(const float* HiddenOutputs, const TBitArray<>* AllowedOutputs) const
+{
+	if (!IsHierarchical())
+	{
+		return QueryOutputLayer(who, HiddenOutputs, AllowedOutputs);
+	}
+
+	FSRDMatrix Result = FSRDMatrix(OutputNodes, 1, 0.0f);
+
+	auto EvaluateRow = [&](const FSRDMatrix& Layer, uint32 Row)
+	{
+		const float* Weights = Layer.R[Row].C.GetData();
+		float Sum = 0;
+		for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+		{
+			Sum += Weights[Col] * HiddenOutputs[Col];
+		}
+		return Activate(Sum, OutputActivation);
+	};
+
+	auto IsGroupAllowed = [&](uint32 Group)
+	{
+		const uint32 GroupEnd = FMath::Min(OutputNodes, (Group + 1) * GroupSize);
+		for (uint32 Idx = Group * GroupSize; Idx < GroupEnd; ++Idx)
+		{
+			if (IsOutputAllowed(AllowedOutputs, Idx))
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	int32 BestGroup = -1;
+	float BestGroupOutput = -MAX_FLT;
+	for (uint32 Group = 0; Group < who.NumRows; ++Group)
+	{
+		if (!IsGroupAllowed(Group))
+		{
+			continue;
+		}
+
+		const float GroupOutput = EvaluateRow(who, Group);
+		if (GroupOutput > BestGroupOutput)
+		{
+			BestGroupOutput = GroupOutput;
+			BestGroup = Group;
+		}
+	}
+
+	if (BestGroup < 0)
+	{
+		return Result;
+	}
+
+	//only the head of the best group is evaluated, other symbols stay 0.
+	const FSRDMatrix& Head = GroupHeads[BestGroup];
+	for (uint32 Row = 0; Row < Head.NumRows; ++Row)
+	{
+		const uint32 OutputIdx = BestGroup * GroupSize + Row;
+		if (IsOutputAllowed(AllowedOutputs, OutputIdx))
+		{
+			Result.R[OutputIdx].C[0] = BestGroupOutput * EvaluateRow(Head, Row);
+		}
+	}
+
+	return Result;
+}
+
+FSRDMatrix FSRNeuralNetwork::QueryOutputLayer(const FSRDMatrix& InWho, const float* HiddenOutputs, const TBitArray<>* AllowedOutputs) const
+{
+	FSRDMatrix Result = FSRDMatrix(OutputNodes, 1, 0.0f);
+	for (uint32 Row = 0; Row < OutputNodes; ++Row)
+	{
+		if (IsOutputAllowed(AllowedOutputs, Row))
+		{
+			const float* Weights = InWho.R[Row].C.GetData();
+			float Sum = 0;
+			for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+			{
+				Sum += Weights[Col] * HiddenOutputs[Col];
+			}
+			Result.R[Row].C[0] = Activate(Sum, OutputActivation);
+		}
+	}
+
+	return Result;
+}
+
+FSRDMatrix FSRNeuralNetwork::GetLayerGradient(FSRDMatrix& Errors, FSRDMatrix& Y, ESRActivationFunc InActivation)
+{
+	if (InActivation == ESRActivationFunc::Sigmoid)
+	{
+		//keep the original evaluation order so sigmoid networks train exactly as before.
+		return Errors.CompWiseMultiply(Y).CompWiseMultiply(1.0f - Y);
+	}
+
+	return Errors.CompWiseMultiply(Y.ActivationDerivativeOperation(ToMatrixActivation(InActivation)));
+}
+
 int32 FSRNeuralNetwork::GetQueryResult(const FSRNeuralNetwork& Neural, const TArray<float>& QueryData, int32 AnswerIdx, float AcceptableAsnwerSize /*= 0.5*/, float DeltaBestAnswers /*= 0.97*/)
 {
-	FSRDMatrix Result = Neural.Query(QueryData);
+	return GetQueryResult(Neural.Query(QueryData), AnswerIdx, AcceptableAsnwerSize, DeltaBestAnswers);
+}
 
+int32 FSRNeuralNetwork::GetQueryResult(const FSRDMatrix& Result, int32 AnswerIdx, float AcceptableAsnwerSize /*= 0.5*/, float DeltaBestAnswers /*= 0.97*/)
+{
 	int32 bestAnswer = -1;
 	float bestSize = 0;
 	float previousSize = 0;
@@ -82,3 +621,27 @@ int32 FSRNeuralNetwork::GetQueryResult(const FSRNeuralNetwork& Neural, const TAr
 
 	return 0;
 }
+
+float FSRNeuralNetwork::GetTopTwoMargin(const FSRDMatrix& Result, int32& OutBestIdx)
+{
+	OutBestIdx = -1;
+	float bestSize = 0;
+	float secondSize = 0;
+
+	for (int32 answerIdx = 0; answerIdx < Result.R.Num(); answerIdx++)
+	{
+		const float answerSize = Result.R[answerIdx].C[0];
+		if (answerSize > bestSize)
+		{
+			secondSize = bestSize;
+			bestSize = answerSize;
+			OutBestIdx = answerIdx;
+		}
+		else if (answerSize > secondSize)
+		{
+			secondSize = answerSize;
+		}
+	}
+
+	return bestSize - secondSize;
+}
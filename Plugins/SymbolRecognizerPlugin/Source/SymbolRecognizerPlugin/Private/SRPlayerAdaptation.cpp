@@ -0,0 +1,178 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#include "SRPlayerAdaptation.h"
+#include "SymbolRecognizerPlugin.h"
+#include "Misc/Crc.h"
+
+
+void FSRPlayerAdaptation::Reset(const FSRNeuralNetwork* InBase, const FSROutputLayerDelta* InSaved)
+{
+	Base = nullptr;
+	AdaptedWho = FSRDMatrix(0, 0, 0.0f);
+	BaseWho = FSRDMatrix(0, 0, 0.0f);
+	Samples.Reset();
+	NextWriteIdx = 0;
+	NextReplayIdx = 0;
+	PendingSteps = 0;
+	ConfirmedSamples = 0;
+	bHasChanges = false;
+
+	if (InBase == nullptr || !InBase->bIsTrained || InBase->IsHierarchical())
+	{
+		return;
+	}
+
+	Base = InBase;
+	AdaptedWho = InBase->who;
+	BaseWho = InBase->who;
+	BaseChecksum = GetWeightsChecksum(*InBase);
+
+	if (InSaved == nullptr)
+	{
+		return;
+	}
+
+	if (InSaved->BaseChecksum != BaseChecksum || InSaved->OutputNodes != InBase->OutputNodes || InSaved->HiddenNodes != InBase->HiddenNodes
+		|| (uint32)InSaved->Delta.Num() != InBase->OutputNodes * InBase->HiddenNodes)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Player adaptation dropped, profile network changed."));
+		return;
+	}
+
+	for (uint32 Row = 0; Row < Base->OutputNodes; ++Row)
+	{
+		float* Weights = AdaptedWho.R[Row].C.GetData();
+		const float* Delta = InSaved->Delta.GetData() + Row * Base->HiddenNodes;
+		for (uint32 Col = 0; Col < Base->HiddenNodes; ++Col)
+		{
+			Weights[Col] += Delta[Col];
+		}
+	}
+	ConfirmedSamples = InSaved->ConfirmedSamples;
+}
+
+bool FSRPlayerAdaptation::IsActive() const
+{
+	//base network replaced without Reset doesn't match the adapted layer anymore.
+	return Base != nullptr && Base->bIsTrained && !Base->IsHierarchical()
+		&& AdaptedWho.NumRows == Base->OutputNodes && AdaptedWho.NumColumns == Base->HiddenNodes;
+}
+
+FSRDMatrix FSRPlayerAdaptation::Query(const TArray<float>& InInput, const TBitArray<>* AllowedOutputs) const
+{
+	if (!IsActive() || (uint32)InInput.Num() < Base->InputNodes)
+	{
+		return FSRDMatrix(Base ? Base->OutputNodes : 0, 1, 0.0f);
+	}
+
+	TArray<float, TInlineAllocator<128>> HiddenOutputs;
+	Base->ForwardHidden(InInput.GetData(), HiddenOutputs);
+	return Base->QueryOutputLayer(AdaptedWho, HiddenOutputs.GetData(), AllowedOutputs);
+}
+
+void FSRPlayerAdaptation::AddConfirmedSample(const TArray<float>& InInput, int32 InSymbolId)
+{
+	if (!IsActive() || (uint32)InInput.Num() != Base->InputNodes || InSymbolId < 0 || (uint32)InSymbolId >= Base->OutputNodes)
+	{
+		return;
+	}
+
+	//wih is never adapted, so hidden layer of a sample doesn't change.
+	FSample NewSample;
+	NewSample.SymbolId = InSymbolId;
+	Base->ForwardHidden(InInput.GetData(), NewSample.HiddenOutputs);
+
+	if (Samples.Num() < BufferSize)
+	{
+		Samples.Add(MoveTemp(NewSample));
+	}
+	else
+	{
+		Samples[NextWriteIdx] = MoveTemp(NewSample);
+	}
+	NextWriteIdx = (NextWriteIdx + 1) % BufferSize;
+
+	PendingSteps += StepsPerSample;
+	ConfirmedSamples++;
+}
+
+int32 FSRPlayerAdaptation::Tick(double InBudgetSeconds)
+{
+	if (!IsActive() || PendingSteps <= 0 || Samples.Num() == 0)
+	{
+		return 0;
+	}
+
+	const double EndTime = FPlatformTime::Seconds() + InBudgetSeconds;
+	int32 StepsDone = 0;
+	do
+	{
+		NextReplayIdx = NextReplayIdx % Samples.Num();
+		Step(Samples[NextReplayIdx++]);
+		PendingSteps--;
+		StepsDone++;
+	} while (PendingSteps > 0 && FPlatformTime::Seconds() < EndTime);
+
+	bHasChanges = true;
+	return StepsDone;
+}
+
+void FSRPlayerAdaptation::Step(const FSample& InSample)
+{
+	const float LearningRate = Base->LearningRate * LearningRateScale;
+	const uint32 HiddenNodes = Base->HiddenNodes;
+	const float* HiddenOutputs = InSample.HiddenOutputs.GetData();
+
+	for (uint32 Row = 0; Row < Base->OutputNodes; ++Row)
+	{
+		float* Weights = AdaptedWho.R[Row].C.GetData();
+		float Sum = 0;
+		for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+		{
+			Sum += Weights[Col] * HiddenOutputs[Col];
+		}
+
+		//same targets as editor training.
+		const float Target = (Row == (uint32)InSample.SymbolId) ? 0.99f : 0.01f;
+		const float Y = FSRNeuralNetwork::Activate(Sum, Base->OutputActivation);
+		const float Scale = LearningRate * FSRNeuralNetwork::GetNodeGradient(Target - Y, Y, Base->OutputActivation);
+		for (uint32 Col = 0; Col < HiddenNodes; ++Col)
+		{
+			Weights[Col] += Scale * HiddenOutputs[Col];
+		}
+	}
+}
+
+void FSRPlayerAdaptation::GetDelta(FSROutputLayerDelta& OutDelta) const
+{
+	OutDelta = FSROutputLayerDelta();
+	if (!IsActive())
+	{
+		return;
+	}
+
+	OutDelta.HiddenNodes = Base->HiddenNodes;
+	OutDelta.OutputNodes = Base->OutputNodes;
+	OutDelta.BaseChecksum = BaseChecksum;
+	OutDelta.ConfirmedSamples = ConfirmedSamples;
+	OutDelta.Delta.SetNumUninitialized(Base->OutputNodes * Base->HiddenNodes);
+	for (uint32 Row = 0; Row < Base->OutputNodes; ++Row)
+	{
+		for (uint32 Col = 0; Col < Base->HiddenNodes; ++Col)
+		{
+			OutDelta.Delta[Row * Base->HiddenNodes + Col] = AdaptedWho.R[Row].C[Col] - BaseWho.R[Row].C[Col];
+		}
+	}
+}
+
+uint32 FSRPlayerAdaptation::GetWeightsChecksum(const FSRNeuralNetwork& InNetwork)
+{
+	//retraining changes who as well, so wih (much bigger) doesn't need to be checked.
+	uint32 Crc = FCrc::MemCrc32(&InNetwork.HiddenNodes, sizeof(InNetwork.HiddenNodes));
+	for (const auto& Row : InNetwork.who.R)
+	{
+		Crc = FCrc::MemCrc32(Row.C.GetData(), Row.C.Num() * sizeof(float), Crc);
+	}
+
+	return Crc;
+}
@@ -0,0 +1,343 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#include "SRPointCloudRecognizer.h"
+#include "SymbolRecognizerPlugin.h"
+
+//average distance of matched points (in unit box space) that gives 0 accuracy.
+static const float SRPointCloudMaxDistance = 0.2f;
+
+
+FSRStrokeSample::FSRStrokeSample(int32 InSymbolId, int32 InImageId, const TArray<FSRDrawLine>& InLines) :
+	SymbolId(InSymbolId),
+	ImageId(InImageId)
+{
+	for (const FSRDrawLine& Line : InLines)
+	{
+		if (Line.Points.Num() > 0)
+		{
+			LineStarts.Add(Points.Num());
+			Points.Append(Line.Points);
+		}
+	}
+}
+
+FSRStrokeSample FSRStrokeSample::FromPixels(int32 InSymbolId, int32 InImageId, const TArray<float>& InImageData, float InThreshold)
+{
+	FSRStrokeSample Sample;
+	Sample.SymbolId = InSymbolId;
+	Sample.ImageId = InImageId;
+	Sample.bFromPixels = true;
+
+	const int32 Size = FMath::RoundToInt(FMath::Sqrt((float)InImageData.Num()));
+	if (Size * Size != InImageData.Num())
+	{
+		return Sample;
+	}
+
+	Sample.LineStarts.Add(0);
+	for (int32 Y = 0; Y < Size; ++Y)
+	{
+		for (int32 X = 0; X < Size; ++X)
+		{
+			if (InImageData[Y * Size + X] > InThreshold)
+			{
+				Sample.Points.Emplace(X + 0.5f, Y + 0.5f);
+			}
+		}
+	}
+
+	return Sample;
+}
+
+void FSRStrokeSample::ToDrawLines(TArray<FSRDrawLine>& OutLines) const
+{
+	OutLines.Reset(LineStarts.Num());
+	for (int32 LineIdx = 0; LineIdx < LineStarts.Num(); ++LineIdx)
+	{
+		const int32 Start = LineStarts[LineIdx];
+		const int32 End = LineStarts.IsValidIndex(LineIdx + 1) ? LineStarts[LineIdx + 1] : Points.Num();
+		if (Start >= End)
+		{
+			continue;
+		}
+
+		FSRDrawLine& Line = OutLines.AddDefaulted_GetRef();
+		Line.Points.Append(Points.GetData() + Start, End - Start);
+	}
+}
+
+////////////////////////////////////////////////////////////
+
+void FSRPointCloudRecognizer::SetTemplates(const TArray<FSRStrokeSample>& InSamples, int32 InSymbolsAmount, bool bInRotationInvariant)
+{
+	Reset();
+	bRotationInvariant = bInRotationInvariant;
+	SymbolsAmount = InSymbolsAmount;
+
+	TArray<FSRDrawLine> Lines;
+	for (const FSRStrokeSample& Sample : InSamples)
+	{
+		if (Sample.SymbolId < 0 || (InSymbolsAmount > 0 && Sample.SymbolId >= InSymbolsAmount))
+		{
+			continue;
+		}
+
+		Sample.ToDrawLines(Lines);
+
+		FCloudTemplate NewTemplate;
+		NewTemplate.SymbolId = Sample.SymbolId;
+		if (Normalize(Lines, Sample.bFromPixels, NewTemplate.Points))
+		{
+			SymbolsAmount = FMath::Max(SymbolsAmount, Sample.SymbolId + 1);
+			Templates.Add(MoveTemp(NewTemplate));
+		}
+	}
+}
+
+void FSRPointCloudRecognizer::Reset()
+{
+	Templates.Empty();
+	SymbolsAmount = 0;
+}
+
+bool FSRPointCloudRecognizer::IsReady() const
+{
+	return Templates.Num() > 0;
+}
+
+FSRDMatrix FSRPointCloudRecognizer::Recognize(const FSRRecognizerInput& Input) const
+{
+	FSRDMatrix Result = FSRDMatrix(SymbolsAmount, 1, 0.0f);
+
+	TArray<FVector2D> Points;
+	if (!Normalize(Input.GetStrokes(), false, Points))
+	{
+		return Result;
+	}
+
+	TArray<float> SymbolDistances;
+	SymbolDistances.Init(MAX_FLT, SymbolsAmount);
+	for (const FCloudTemplate& Template : Templates)
+	{
+		if (!Input.IsSymbolAllowed(Template.SymbolId))
+		{
+			continue;
+		}
+
+		float& SymbolDistance = SymbolDistances[Template.SymbolId];
+		SymbolDistance = FMath::Min(SymbolDistance, GreedyCloudMatch(Points, Template.Points, SymbolDistance));
+	}
+
+	const float WeightsSum = (NumPoints + 1) * 0.5f;
+	for (int32 SymbolId = 0; SymbolId < SymbolsAmount; ++SymbolId)
+	{
+		if (SymbolDistances[SymbolId] < MAX_FLT)
+		{
+			const float AverageDistance = SymbolDistances[SymbolId] / WeightsSum;
+			Result.R[SymbolId].C[0] = FMath::Clamp(1.0f - AverageDistance / SRPointCloudMaxDistance, 0.0f, 1.0f);
+		}
+	}
+
+	return Result;
+}
+
+float FSRPointCloudRecognizer::Classify(const TArray<FSRDrawLine>& InLines, int32& OutBestSymbol) const
+{
+	OutBestSymbol = -1;
+
+	TArray<FVector2D> Points;
+	if (!Normalize(InLines, false, Points))
+	{
+		return MAX_FLT;
+	}
+
+	float BestDistance = MAX_FLT;
+	for (const FCloudTemplate& Template : Templates)
+	{
+		const float Distance = GreedyCloudMatch(Points, Template.Points, BestDistance);
+		if (Distance < BestDistance)
+		{
+			BestDistance = Distance;
+			OutBestSymbol = Template.SymbolId;
+		}
+	}
+
+	return (OutBestSymbol > -1) ? BestDistance / ((NumPoints + 1) * 0.5f) : MAX_FLT;
+}
+
+bool FSRPointCloudRecognizer::Normalize(const TArray<FSRDrawLine>& InLines, bool bInCloud, TArray<FVector2D>& OutPoints) const
+{
+	OutPoints.Reset(NumPoints);
+
+	int32 RawCount = 0;
+	float PathLength = 0.0f;
+	for (const FSRDrawLine& Line : InLines)
+	{
+		RawCount += Line.Points.Num();
+		for (int32 I = 1; I < Line.Points.Num(); ++I)
+		{
+			PathLength += FVector2D::Distance(Line.Points[I - 1], Line.Points[I]);
+		}
+	}
+
+	if (RawCount == 0)
+	{
+		return false;
+	}
+
+	if (bInCloud || PathLength <= KINDA_SMALL_NUMBER)
+	{
+		//no path to walk along (pixels or dots only), pick evenly spread points.
+		TArray<FVector2D> RawPoints;
+		RawPoints.Reserve(RawCount);
+		for (const FSRDrawLine& Line : InLines)
+		{
+			RawPoints.Append(Line.Points);
+		}
+
+		for (int32 I = 0; I < NumPoints; ++I)
+		{
+			OutPoints.Add(RawPoints[(int64)I * RawPoints.Num() / NumPoints]);
+		}
+	}
+	else
+	{
+		//resample: equidistant points along strokes, gaps between strokes are not part of the path.
+		const float Interval = PathLength / (NumPoints - 1);
+		float AccumulatedDistance = 0.0f;
+		FVector2D LastPoint = FVector2D::ZeroVector;
+
+		for (const FSRDrawLine& Line : InLines)
+		{
+			if (Line.Points.Num() == 0)
+			{
+				continue;
+			}
+
+			FVector2D Previous = Line.Points[0];
+			if (OutPoints.Num() == 0)
+			{
+				OutPoints.Add(Previous);
+			}
+
+			for (int32 I = 1; I < Line.Points.Num() && OutPoints.Num() < NumPoints; ++I)
+			{
+				const FVector2D& Current = Line.Points[I];
+				float Distance = FVector2D::Distance(Previous, Current);
+
+				while (Distance > 0.0f && AccumulatedDistance + Distance >= Interval && OutPoints.Num() < NumPoints)
+				{
+					Previous = FMath::Lerp(Previous, Current, (Interval - AccumulatedDistance) / Distance);
+					OutPoints.Add(Previous);
+					Distance = FVector2D::Distance(Previous, Current);
+					AccumulatedDistance = 0.0f;
+				}
+
+				AccumulatedDistance += Distance;
+				Previous = Current;
+			}
+
+			LastPoint = Line.Points.Last();
+		}
+
+		//floating point errors may leave the last point out.
+		while (OutPoints.Num() < NumPoints)
+		{
+			OutPoints.Add(LastPoint);
+		}
+	}
+
+	//scale to unit box.
+	FVector2D Min(MAX_FLT, MAX_FLT);
+	FVector2D Max(-MAX_FLT, -MAX_FLT);
+	for (const FVector2D& Point : OutPoints)
+	{
+		Min = Min.ComponentMin(Point);
+		Max = Max.ComponentMax(Point);
+	}
+
+	const float Size = FMath::Max(Max.X - Min.X, Max.Y - Min.Y);
+	const float InvSize = (Size > KINDA_SMALL_NUMBER) ? 1.0f / Size : 1.0f;
+
+	FVector2D Centroid = FVector2D::ZeroVector;
+	for (FVector2D& Point : OutPoints)
+	{
+		Point = (Point - Min) * InvSize;
+		Centroid += Point;
+	}
+	Centroid /= NumPoints;
+
+	//translate to centroid.
+	for (FVector2D& Point : OutPoints)
+	{
+		Point -= Centroid;
+	}
+
+	//rotate so the first point always lies on the same axis.
+	if (bRotationInvariant && !OutPoints[0].IsNearlyZero())
+	{
+		const float Angle = -FMath::Atan2(OutPoints[0].Y, OutPoints[0].X);
+		const float Cos = FMath::Cos(Angle);
+		const float Sin = FMath::Sin(Angle);
+		for (FVector2D& Point : OutPoints)
+		{
+			Point = FVector2D(Point.X * Cos - Point.Y * Sin, Point.X * Sin + Point.Y * Cos);
+		}
+	}
+
+	return true;
+}
+
+float FSRPointCloudRecognizer::GreedyCloudMatch(const TArray<FVector2D>& InPoints, const TArray<FVector2D>& InTemplate, float InMinSoFar)
+{
+	//n^(1-epsilon) starting points, epsilon = 0.5
+	const int32 Step = FMath::Max(1, FMath::FloorToInt(FMath::Sqrt((float)NumPoints)));
+
+	float MinDistance = InMinSoFar;
+	for (int32 Start = 0; Start < NumPoints; Start += Step)
+	{
+		MinDistance = FMath::Min(MinDistance, CloudDistance(InPoints, InTemplate, Start, MinDistance));
+		MinDistance = FMath::Min(MinDistance, CloudDistance(InTemplate, InPoints, Start, MinDistance));
+	}
+
+	return MinDistance;
+}
+
+float FSRPointCloudRecognizer::CloudDistance(const TArray<FVector2D>& InPoints, const TArray<FVector2D>& InTemplate, int32 InStart, float InMinSoFar)
+{
+	bool Matched[NumPoints] = { false };
+
+	float Sum = 0.0f;
+	int32 I = InStart;
+	do
+	{
+		int32 MatchIdx = -1;
+		float MatchDistance = MAX_FLT;
+		for (int32 J = 0; J < NumPoints; ++J)
+		{
+			if (!Matched[J])
+			{
+				const float DistSquared = FVector2D::DistSquared(InPoints[I], InTemplate[J]);
+				if (DistSquared < MatchDistance)
+				{
+					MatchDistance = DistSquared;
+					MatchIdx = J;
+				}
+			}
+		}
+
+		Matched[MatchIdx] = true;
+		const float Weight = 1.0f - ((I - InStart + NumPoints) % NumPoints) / (float)NumPoints;
+		Sum += Weight * FMath::Sqrt(MatchDistance);
+
+		//early abandoning: this start can not beat the best match anymore.
+		if (Sum >= InMinSoFar)
+		{
+			return Sum;
+		}
+
+		I = (I + 1) % NumPoints;
+	} while (I != InStart);
+
+	return Sum;
+}
@@ -0,0 +1,310 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#include "SRQuantizedNetwork.h"
+#include "SymbolRecognizerPlugin.h"
+
+#if defined(__AVX2__)
+	#define SR_INT8_KERNEL_AVX2 1
+	#include <immintrin.h>
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && (defined(__SSE4_1__) || defined(__AVX__))
+	#define SR_INT8_KERNEL_SSE41 1
+	#include <smmintrin.h>
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY
+	//MSVC does not announce SSE4.1 without /arch:AVX, so widen with SSE2 shifts instead of pmovsxbw.
+	#define SR_INT8_KERNEL_SSE2 1
+	#include <emmintrin.h>
+#elif PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+	#define SR_INT8_KERNEL_NEON 1
+	#include <arm_neon.h>
+#endif
+
+#ifndef SR_INT8_KERNEL_AVX2
+	#define SR_INT8_KERNEL_AVX2 0
+#endif
+#ifndef SR_INT8_KERNEL_SSE41
+	#define SR_INT8_KERNEL_SSE41 0
+#endif
+#ifndef SR_INT8_KERNEL_SSE2
+	#define SR_INT8_KERNEL_SSE2 0
+#endif
+#ifndef SR_INT8_KERNEL_NEON
+	#define SR_INT8_KERNEL_NEON 0
+#endif
+
+static const uint32 SRInt8RowAlignment = 32;
+
+const TCHAR* FSRQuantizedNetwork::GetKernelName()
+{
+#if SR_INT8_KERNEL_AVX2
+	return TEXT("AVX2");
+#elif SR_INT8_KERNEL_SSE41
+	return TEXT("SSE4.1");
+#elif SR_INT8_KERNEL_SSE2
+	return TEXT("SSE2");
+#elif SR_INT8_KERNEL_NEON && defined(__ARM_FEATURE_DOTPROD)
+	return TEXT("NEON DotProd");
+#elif SR_INT8_KERNEL_NEON
+	return TEXT("NEON");
+#else
+	return TEXT("Scalar");
+#endif
+}
+
+int32 FSRQuantizedNetwork::DotProduct(const int8* A, const int8* B, uint32 Count)
+{
+	//Count is always a multiple of SRInt8RowAlignment.
+#if SR_INT8_KERNEL_AVX2
+	__m256i Acc = _mm256_setzero_si256();
+	for (uint32 I = 0; I < Count; I += 32)
+	{
+		const __m256i VA = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(A + I));
+		const __m256i VB = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(B + I));
+		const __m256i ALo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(VA));
+		const __m256i AHi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(VA, 1));
+		const __m256i BLo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(VB));
+		const __m256i BHi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(VB, 1));
+		Acc = _mm256_add_epi32(Acc, _mm256_madd_epi16(ALo, BLo));
+		Acc = _mm256_add_epi32(Acc, _mm256_madd_epi16(AHi, BHi));
+	}
+	__m128i Sum = _mm_add_epi32(_mm256_castsi256_si128(Acc), _mm256_extracti128_si256(Acc, 1));
+	Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(Sum);
+#elif SR_INT8_KERNEL_SSE41 || SR_INT8_KERNEL_SSE2
+	__m128i Acc = _mm_setzero_si128();
+	for (uint32 I = 0; I < Count; I += 16)
+	{
+		const __m128i VA = _mm_loadu_si128(reinterpret_cast<const __m128i*>(A + I));
+		const __m128i VB = _mm_loadu_si128(reinterpret_cast<const __m128i*>(B + I));
+	#if SR_INT8_KERNEL_SSE41
+		const __m128i ALo = _mm_cvtepi8_epi16(VA);
+		const __m128i AHi = _mm_cvtepi8_epi16(_mm_srli_si128(VA, 8));
+		const __m128i BLo = _mm_cvtepi8_epi16(VB);
+		const __m128i BHi = _mm_cvtepi8_epi16(_mm_srli_si128(VB, 8));
+	#else
+		const __m128i ALo = _mm_srai_epi16(_mm_unpacklo_epi8(VA, VA), 8);
+		const __m128i AHi = _mm_srai_epi16(_mm_unpackhi_epi8(VA, VA), 8);
+		const __m128i BLo = _mm_srai_epi16(_mm_unpacklo_epi8(VB, VB), 8);
+		const __m128i BHi = _mm_srai_epi16(_mm_unpackhi_epi8(VB, VB), 8);
+	#endif
+		Acc = _mm_add_epi32(Acc, _mm_madd_epi16(ALo, BLo));
+		Acc = _mm_add_epi32(Acc, _mm_madd_epi16(AHi, BHi));
+	}
+	Acc = _mm_add_epi32(Acc, _mm_shuffle_epi32(Acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	Acc = _mm_add_epi32(Acc, _mm_shuffle_epi32(Acc, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(Acc);
+#elif SR_INT8_KERNEL_NEON
+	int32x4_t Acc = vdupq_n_s32(0);
+	for (uint32 I = 0; I < Count; I += 16)
+	{
+		const int8x16_t VA = vld1q_s8(A + I);
+		const int8x16_t VB = vld1q_s8(B + I);
+	#if defined(__ARM_FEATURE_DOTPROD)
+		Acc = vdotq_s32(Acc, VA, VB);
+	#else
+		int16x8_t Prod = vmull_s8(vget_low_s8(VA), vget_low_s8(VB));
+		Prod = vmlal_s8(Prod, vget_high_s8(VA), vget_high_s8(VB));
+		Acc = vpadalq_s16(Acc, Prod);
+	#endif
+	}
+	#if PLATFORM_64BITS
+	return vaddvq_s32(Acc);
+	#else
+	const int32x2_t Pair = vadd_s32(vget_low_s32(Acc), vget_high_s32(Acc));
+	return vget_lane_s32(vpadd_s32(Pair, Pair), 0);
+	#endif
+#else
+	int32 Acc = 0;
+	for (uint32 I = 0; I < Count; ++I)
+	{
+		Acc += int32(A[I]) * int32(B[I]);
+	}
+	return Acc;
+#endif
+}
+
+uint32 FSRQuantizedNetwork::GetPaddedStride(uint32 InCount)
+{
+	return ((InCount + SRInt8RowAlignment - 1) / SRInt8RowAlignment) * SRInt8RowAlignment;
+}
+
+int8 FSRQuantizedNetwork::QuantizeValue(float InValue, float InInvScale)
+{
+	return (int8)FMath::Clamp(FMath::RoundToInt(InValue * InInvScale), -127, 127);
+}
+
+void FSRQuantizedNetwork::QuantizeRow(const TArray<float>& InRow, uint32 InStride, TArray<int8>& OutData, float& OutScale)
+{
+	float MaxAbs = 0.0f;
+	for (float Value : InRow)
+	{
+		MaxAbs = FMath::Max(MaxAbs, FMath::Abs(Value));
+	}
+
+	OutScale = (MaxAbs > 0.0f) ? MaxAbs / 127.0f : 1.0f;
+	const float InvScale = 1.0f / OutScale;
+
+	const int32 RowStart = OutData.AddZeroed(InStride);
+	for (int32 Col = 0; Col < InRow.Num(); ++Col)
+	{
+		OutData[RowStart + Col] = QuantizeValue(InRow[Col], InvScale);
+	}
+}
+
+bool FSRQuantizedNetwork::Build(const FSRNeuralNetwork& InNetwork, const TArray<TArray<float>>& CalibrationInputs)
+{
+	bIsValid = false;
+	AgreementRate = 0.0f;
+
+	//two-level output is not supported, only flat networks get converted.
+	if (!InNetwork.bIsTrained || InNetwork.IsHierarchical() || CalibrationInputs.Num() == 0)
+	{
+		return false;
+	}
+
+	InputNodes = InNetwork.InputNodes;
+	HiddenNodes = InNetwork.HiddenNodes;
+	OutputNodes = InNetwork.OutputNodes;
+	HiddenActivation = InNetwork.HiddenActivation;
+	OutputActivation = InNetwork.OutputActivation;
+	InputStride = GetPaddedStride(InputNodes);
+	HiddenStride = GetPaddedStride(HiddenNodes);
+
+	//weights: symmetric per-row scale.
+	wih.Reset(HiddenNodes * InputStride);
+	wihScales.Reset(HiddenNodes);
+	for (uint32 Row = 0; Row < HiddenNodes; ++Row)
+	{
+		QuantizeRow(InNetwork.wih.R[Row].C, InputStride, wih, wihScales.AddDefaulted_GetRef());
+	}
+
+	who.Reset(OutputNodes * HiddenStride);
+	whoScales.Reset(OutputNodes);
+	for (uint32 Row = 0; Row < OutputNodes; ++Row)
+	{
+		QuantizeRow(InNetwork.who.R[Row].C, HiddenStride, who, whoScales.AddDefaulted_GetRef());
+	}
+
+	//activations: find the largest value seen on calibration images.
+	float MaxInput = 0.0f;
+	float MaxHidden = 0.0f;
+	for (const TArray<float>& Input : CalibrationInputs)
+	{
+		if ((uint32)Input.Num() < InputNodes)
+		{
+			continue;
+		}
+
+		for (uint32 Col = 0; Col < InputNodes; ++Col)
+		{
+			MaxInput = FMath::Max(MaxInput, FMath::Abs(Input[Col]));
+		}
+
+		for (uint32 Row = 0; Row < HiddenNodes; ++Row)
+		{
+			const TArray<float>& Weights = InNetwork.wih.R[Row].C;
+			float HiddenInput = 0.0f;
+			for (uint32 Col = 0; Col < InputNodes; ++Col)
+			{
+				HiddenInput += Weights[Col] * Input[Col];
+			}
+			MaxHidden = FMath::Max(MaxHidden, FMath::Abs(FSRNeuralNetwork::Activate(HiddenInput, HiddenActivation)));
+		}
+	}
+
+	InputScale = (MaxInput > 0.0f) ? MaxInput / 127.0f : 1.0f;
+	HiddenScale = (MaxHidden > 0.0f) ? MaxHidden / 127.0f : 1.0f;
+	bIsValid = true;
+
+	AgreementRate = MeasureAgreement(InNetwork, CalibrationInputs);
+
+	UE_LOG(LogTemp, Log, TEXT("Quantized network (%s kernel): %u KB -> %u KB, agreement with float model: %.2f%%"),
+		GetKernelName(),
+		(InputNodes * HiddenNodes + HiddenNodes * OutputNodes) * (uint32)sizeof(float) / 1024,
+		(uint32)(wih.Num() + who.Num()) / 1024,
+		AgreementRate * 100.0f);
+
+	return true;
+}
+
+float FSRQuantizedNetwork::MeasureAgreement(const FSRNeuralNetwork& InNetwork, const TArray<TArray<float>>& Inputs) const
+{
+	if (!bIsValid || Inputs.Num() == 0)
+	{
+		return 0.0f;
+	}
+
+	int32 Agreed = 0;
+	TArray<float> QuantizedResult;
+
+	for (const TArray<float>& Input : Inputs)
+	{
+		FSRDMatrix FloatResult = InNetwork.Query(Input);
+		Query(Input, QuantizedResult);
+
+		int32 FloatBest = 0;
+		int32 QuantizedBest = 0;
+		for (int32 Idx = 1; Idx < QuantizedResult.Num(); ++Idx)
+		{
+			if (FloatResult.R[Idx].C[0] > FloatResult.R[FloatBest].C[0])
+			{
+				FloatBest = Idx;
+			}
+			if (QuantizedResult[Idx] > QuantizedResult[QuantizedBest])
+			{
+				QuantizedBest = Idx;
+			}
+		}
+
+		Agreed += (FloatBest == QuantizedBest) ? 1 : 0;
+	}
+
+	return Agreed / (float)Inputs.Num();
+}
+
+FSRDMatrix FSRQuantizedNetwork::Query(const TArray<float>& InputList, const TBitArray<>* AllowedOutputs) const
+{
+	TArray<float> Result;
+	Query(InputList, Result, AllowedOutputs);
+	return FSRDMatrix(OutputNodes, 1, Result);
+}
+
+void FSRQuantizedNetwork::Query(const TArray<float>& InputList, TArray<float>& OutResult, const TBitArray<>* AllowedOutputs) const
+{
+	OutResult.SetNumZeroed(OutputNodes);
+
+	if (!bIsValid)
+	{
+		return;
+	}
+
+	TArray<int8> QuantizedInput;
+	QuantizedInput.AddZeroed(InputStride);
+	const float InvInputScale = 1.0f / InputScale;
+	const uint32 InputsToRead = FMath::Min<uint32>(InputNodes, InputList.Num());
+	for (uint32 Col = 0; Col < InputsToRead; ++Col)
+	{
+		QuantizedInput[Col] = QuantizeValue(InputList[Col], InvInputScale);
+	}
+
+	TArray<int8> QuantizedHidden;
+	QuantizedHidden.AddZeroed(HiddenStride);
+	const float InvHiddenScale = 1.0f / HiddenScale;
+	for (uint32 Row = 0; Row < HiddenNodes; ++Row)
+	{
+		const int32 Acc = DotProduct(&wih[Row * InputStride], QuantizedInput.GetData(), InputStride);
+		const float HiddenOutput = FSRNeuralNetwork::Activate(Acc * wihScales[Row] * InputScale, HiddenActivation);
+		QuantizedHidden[Row] = QuantizeValue(HiddenOutput, InvHiddenScale);
+	}
+
+	for (uint32 Row = 0; Row < OutputNodes; ++Row)
+	{
+		if (!FSRNeuralNetwork::IsOutputAllowed(AllowedOutputs, Row))
+		{
+			continue;
+		}
+
+		const int32 Acc = DotProduct(&who[Row * HiddenStride], QuantizedHidden.GetData(), HiddenStride);
+		OutResult[Row] = FSRNeuralNetwork::Activate(Acc * whoScales[Row] * HiddenScale, OutputActivation);
+	}
+}
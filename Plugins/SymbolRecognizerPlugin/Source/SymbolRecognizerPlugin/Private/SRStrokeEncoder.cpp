@@ -0,0 +1,114 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#include "SRStrokeEncoder.h"
+#include "SymbolRecognizerPlugin.h"
+
+//segments are split into steps of this length (in unit square space) so long lines fill every cell they cross.
+static const float SRStrokeEncoderStep = 0.5f / FSRStrokeEncoder::GridSize;
+
+
+bool FSRStrokeEncoder::Encode(const TArray<FSRDrawLine>& InLines, TArray<float>& OutDescriptor)
+{
+	OutDescriptor.Init(0.0f, GetDescriptorSize());
+
+	FVector2D Min(MAX_FLT, MAX_FLT);
+	FVector2D Max(-MAX_FLT, -MAX_FLT);
+	int32 PointsCount = 0;
+	for (const FSRDrawLine& Line : InLines)
+	{
+		for (const FVector2D& Point : Line.Points)
+		{
+			Min = Min.ComponentMin(Point);
+			Max = Max.ComponentMax(Point);
+			PointsCount++;
+		}
+	}
+
+	if (PointsCount == 0)
+	{
+		for (float& Value : OutDescriptor)
+		{
+			Value = 0.01f;
+		}
+		return false;
+	}
+
+	//fit to unit square keeping proportions, centered like the canvas texture.
+	const FVector2D Size = Max - Min;
+	const float MaxSize = FMath::Max(Size.X, Size.Y);
+	const float InvSize = (MaxSize > KINDA_SMALL_NUMBER) ? 1.0f / MaxSize : 1.0f;
+	const FVector2D Offset = (FVector2D::UnitVector - Size * InvSize) * 0.5f;
+
+	auto ToUnit = [&](const FVector2D& InPoint)
+	{
+		return (InPoint - Min) * InvSize + Offset;
+	};
+
+	auto GetCellIdx = [](const FVector2D& InUnitPoint)
+	{
+		const int32 CellX = FMath::Clamp(FMath::FloorToInt(InUnitPoint.X * GridSize), 0, GridSize - 1);
+		const int32 CellY = FMath::Clamp(FMath::FloorToInt(InUnitPoint.Y * GridSize), 0, GridSize - 1);
+		return (CellY * GridSize + CellX) * Orientations;
+	};
+
+	for (const FSRDrawLine& Line : InLines)
+	{
+		if (Line.Points.Num() == 1)
+		{
+			//single dot has no orientation, spread it over all bins of its cell.
+			const int32 CellIdx = GetCellIdx(ToUnit(Line.Points[0]));
+			for (int32 Bin = 0; Bin < Orientations; ++Bin)
+			{
+				OutDescriptor[CellIdx + Bin] += SRStrokeEncoderStep / Orientations;
+			}
+			continue;
+		}
+
+		for (int32 I = 1; I < Line.Points.Num(); ++I)
+		{
+			const FVector2D Start = ToUnit(Line.Points[I - 1]);
+			const FVector2D End = ToUnit(Line.Points[I]);
+			const FVector2D Segment = End - Start;
+			const float Length = Segment.Size();
+			if (Length <= KINDA_SMALL_NUMBER)
+			{
+				continue;
+			}
+
+			//soft assignment between two nearest orientation bins.
+			float Angle = FMath::Atan2(Segment.Y, Segment.X);
+			if (Angle < 0.0f)
+			{
+				Angle += PI;
+			}
+			const float BinPos = Angle / PI * Orientations - 0.5f;
+			const int32 LowerBin = FMath::FloorToInt(BinPos);
+			const float UpperWeight = BinPos - LowerBin;
+			const int32 BinA = (LowerBin + Orientations) % Orientations;
+			const int32 BinB = (LowerBin + 1) % Orientations;
+
+			const int32 Steps = FMath::Max(1, FMath::CeilToInt(Length / SRStrokeEncoderStep));
+			const float StepLength = Length / Steps;
+			for (int32 Step = 0; Step < Steps; ++Step)
+			{
+				const int32 CellIdx = GetCellIdx(Start + Segment * ((Step + 0.5f) / Steps));
+				OutDescriptor[CellIdx + BinA] += StepLength * (1.0f - UpperWeight);
+				OutDescriptor[CellIdx + BinB] += StepLength * UpperWeight;
+			}
+		}
+	}
+
+	float MaxValue = 0.0f;
+	for (float Value : OutDescriptor)
+	{
+		MaxValue = FMath::Max(MaxValue, Value);
+	}
+
+	const float InvMaxValue = (MaxValue > 0.0f) ? 1.0f / MaxValue : 0.0f;
+	for (float& Value : OutDescriptor)
+	{
+		Value = Value * InvMaxValue * 0.98f + 0.01f;
+	}
+
+	return true;
+}
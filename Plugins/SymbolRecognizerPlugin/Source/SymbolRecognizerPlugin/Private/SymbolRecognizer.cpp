@@ -5,7 +5,20 @@
 #include "SRCanvasHandler.h"
 #include "Runtime/CoreUObject/Public/UObject/Package.h"
 #include "SRAccuracyTesting.h"
+#include "SRStrokeEncoder.h"
 #include "Runtime/AssetRegistry/Public/AssetRegistryModule.h"
+#include "Kismet/GameplayStatics.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarSRModelVariant(
+	TEXT("sr.ModelVariant"),
+	-1,
+	TEXT("Forces model variant used by symbol recognizer (when available for current profile).\n")
+	TEXT("-1: automatic (default)\n")
+	TEXT(" 0: full\n")
+	TEXT(" 1: pruned\n")
+	TEXT(" 2: quantized"),
+	ECVF_Default);
 
 const FString USymbolRecognizer::SymbolRecognizerMountPoint = "/SymbolRecognizerPlugin/";
 const FString USymbolRecognizer::SRDataDir = "Content/SymbolRecognizer/Data/";
@@ -91,16 +104,155 @@ void USymbolRecognizer::PostLoad()
 
 int32 USymbolRecognizer::GetMostAccurateSymbol(float AccuracyThreshold /*= 0.3f*/) const
 {
-	TArray<float> QueryData;
-	GetCanvasHandler()->GetDataFromTexture(QueryData);
+	return PickMostAccurateSymbol(Recognize(nullptr), nullptr, AccuracyThreshold);
+}
+
+TArray<float> USymbolRecognizer::GetAccuracyList() const
+{
+	FSRDMatrix Result = Recognize(nullptr);
+
+	TArray<float> ResultList;
+	for (int32 I = 0; I < Result.R.Num(); ++I)
+	{
+		ResultList.Add(Result.R[I].C[0]);
+	}
+
+	return ResultList;
+}
+
+int32 USymbolRecognizer::GetMostAccurateSymbolFromSet(const TArray<int32>& AllowedSymbols, float AccuracyThreshold /*= 0.3f*/) const
+{
+	return GetMostAccurateAllowedSymbol(MakeSymbolsMask(AllowedSymbols), AccuracyThreshold);
+}
+
+int32 USymbolRecognizer::GetMostAccurateAllowedSymbol(const TBitArray<>& AllowedSymbols, float AccuracyThreshold /*= 0.3f*/) const
+{
+	//threshold is checked against raw accuracy, so a scribble is not accepted just because a single symbol is allowed.
+	return PickMostAccurateSymbol(Recognize(&AllowedSymbols), &AllowedSymbols, AccuracyThreshold);
+}
+
+TArray<float> USymbolRecognizer::GetAllowedAccuracyList(const TBitArray<>& AllowedSymbols) const
+{
+	FSRDMatrix Result = Recognize(&AllowedSymbols);
+
+	TArray<float> ResultList;
+	float AllowedSum = 0.0f;
+	for (int32 I = 0; I < Result.R.Num(); ++I)
+	{
+		const float Accuracy = FSRNeuralNetwork::IsOutputAllowed(&AllowedSymbols, I) ? Result.R[I].C[0] : 0.0f;
+		ResultList.Add(Accuracy);
+		AllowedSum += Accuracy;
+	}
+
+	if (AllowedSum > 0.0f)
+	{
+		for (float& Accuracy : ResultList)
+		{
+			Accuracy /= AllowedSum;
+		}
+	}
+
+	return ResultList;
+}
+
+TBitArray<> USymbolRecognizer::MakeSymbolsMask(const TArray<int32>& InSymbols)
+{
+	TBitArray<> Mask;
+	for (int32 SymbolId : InSymbols)
+	{
+		if (SymbolId < 0)
+		{
+			continue;
+		}
+
+		while (Mask.Num() <= SymbolId)
+		{
+			Mask.Add(false);
+		}
+		Mask[SymbolId] = true;
+	}
+
+	return Mask;
+}
+
+int32 USymbolRecognizer::GetLiveBestGuess(float& OutAccuracy)
+{
+	ConsumePublishedNetwork();
+	const USRCanvasHandler* Canvas = GetCanvasHandler();
+	if (!bLiveQueryDirty && Canvas->GetDrawRevision() == LiveQueryRevision)
+	{
+		OutAccuracy = LiveBestAccuracy;
+		return LiveBestGuess;
+	}
+
+	LiveQueryRevision = Canvas->GetDrawRevision();
+	LiveBestGuess = -1;
+	LiveBestAccuracy = 0.0f;
+
+	if (Canvas->GetDrawLinesRef().Num() > 0)
+	{
+		FSRDMatrix Result;
+		if (&GetActiveBackend() == &NetworkBackend)
+		{
+			if (bLiveQueryDirty)
+			{
+				const FSRDMatrix* OutputLayer;
+				const FSRNeuralNetwork& Network = GetRecognitionNetwork(OutputLayer);
+				LiveQuery.Reset(&Network, OutputLayer);
+				bLiveQueryDirty = false;
+			}
+
+			//stroke descriptor doesn't need render target read back.
+			TArray<float> InputData;
+			if (NeuralNetwork.InputEncoding == ESRInputEncoding::StrokeDirections)
+			{
+				FSRStrokeEncoder::Encode(Canvas->GetDrawLinesRef(), InputData);
+			}
+			else
+			{
+				Canvas->GetDataFromTexture(InputData);
+			}
+			Result = LiveQuery.Update(InputData);
+		}
+		else
+		{
+			Result = Recognize(nullptr);
+		}
+
+		for (int32 SymbolIdx = 0; SymbolIdx < Result.R.Num(); ++SymbolIdx)
+		{
+			if (Result.R[SymbolIdx].C[0] > LiveBestAccuracy)
+			{
+				LiveBestAccuracy = Result.R[SymbolIdx].C[0];
+				LiveBestGuess = SymbolIdx;
+			}
+		}
+	}
 
-	FSRDMatrix Result = NeuralNetwork.Query(QueryData);
+	OutAccuracy = LiveBestAccuracy;
+	return LiveBestGuess;
+}
+
+FSRDMatrix USymbolRecognizer::Recognize(const TBitArray<>* AllowedSymbols) const
+{
+	ConsumePublishedNetwork();
+	FSRRecognizerInput Input(GetCanvasHandler());
+	Input.SetAllowedSymbols(AllowedSymbols);
+	return GetActiveBackend().Recognize(Input);
+}
 
+int32 USymbolRecognizer::PickMostAccurateSymbol(const FSRDMatrix& Result, const TBitArray<>* AllowedSymbols, float AccuracyThreshold) const
+{
 	float bestResult = 0;
 	int32 bestAnswerIdx = -1;
 
 	for (int32 SymbolIdx = 0; SymbolIdx < Result.R.Num(); ++SymbolIdx)
 	{
+		if (!FSRNeuralNetwork::IsOutputAllowed(AllowedSymbols, SymbolIdx))
+		{
+			continue;
+		}
+
 		if (Result.R[SymbolIdx].C[0] > 0.9f)
 		{
 			UE_LOG(LogTemp, Error, TEXT("AnswerID: %i | Result: %f"), SymbolIdx, Result.R[SymbolIdx].C[0]);
@@ -129,20 +281,104 @@ int32 USymbolRecognizer::GetMostAccurateSymbol(float AccuracyThreshold /*= 0.3f*
 	return bestAnswerIdx;
 }
 
-TArray<float> USymbolRecognizer::GetAccuracyList() const
+FSRDMatrix USymbolRecognizer::QueryNetwork(const TArray<float>& QueryData, const TBitArray<>* AllowedSymbols) const
 {
-	TArray<float> QueryData;
-	GetCanvasHandler()->GetDataFromTexture(QueryData);
+	if (PreviewNetwork.IsValid())
+	{
+		return PreviewNetwork->Query(QueryData, AllowedSymbols);
+	}
 
-	FSRDMatrix Result = NeuralNetwork.Query(QueryData);
+	if (IsUsingPlayerAdaptation())
+	{
+		return PlayerAdaptation.Query(QueryData, AllowedSymbols);
+	}
 
-	TArray<float> ResultList;
-	for (int32 I = 0; I < Result.R.Num(); ++I)
+	const bool bHasCascade = CascadeNetwork.bIsTrained
+		&& CascadeNetwork.InputNodes == NeuralNetwork.InputNodes
+		&& CascadeNetwork.OutputNodes == NeuralNetwork.OutputNodes;
+
+	if (bHasCascade)
 	{
-		ResultList.Add(Result.R[I].C[0]);
+		FSRDMatrix CascadeResult = CascadeNetwork.Query(QueryData, AllowedSymbols);
+		int32 CascadeBestIdx;
+		const float CascadeMargin = FSRNeuralNetwork::GetTopTwoMargin(CascadeResult, CascadeBestIdx);
+		const bool bEarlyExit = CascadeMargin > CascadeExitMargin;
+
+		CascadeQueries++;
+		CascadeEarlyExits += bEarlyExit ? 1 : 0;
+		if (CascadeQueries % CascadeLogInterval == 0)
+		{
+			LogCascadeEarlyExitRate();
+		}
+
+		if (bEarlyExit)
+		{
+			return CascadeResult;
+		}
 	}
 
-	return ResultList;
+	return QueryModelVariant(GetActiveModelVariant(), QueryData, AllowedSymbols);
+}
+
+FSRDMatrix USymbolRecognizer::QueryModelVariant(ESRModelVariant InVariant, const TArray<float>& QueryData, const TBitArray<>* AllowedSymbols) const
+{
+	switch (InVariant)
+	{
+	case ESRModelVariant::Pruned:
+		return PrunedNetwork.Query(QueryData, AllowedSymbols);
+	case ESRModelVariant::Quantized:
+		return QuantizedNetwork.Query(QueryData, AllowedSymbols);
+	default:
+		return NeuralNetwork.Query(QueryData, AllowedSymbols);
+	}
+}
+
+bool FSRNetworkBackend::IsReady() const
+{
+	return Owner->NeuralNetwork.bIsTrained || Owner->IsPreviewingNetwork();
+}
+
+FSRDMatrix FSRNetworkBackend::Recognize(const FSRRecognizerInput& Input) const
+{
+	if (Owner->NeuralNetwork.InputEncoding == ESRInputEncoding::StrokeDirections)
+	{
+		TArray<float> Descriptor;
+		FSRStrokeEncoder::Encode(Input.GetStrokes(), Descriptor);
+		return Owner->QueryNetwork(Descriptor, Input.GetAllowedSymbols());
+	}
+
+	return Owner->QueryNetwork(Input.GetImageData(), Input.GetAllowedSymbols());
+}
+
+void USymbolRecognizer::SetRecognizerBackend(ESRRecognizerBackend InBackend)
+{
+	RecognizerBackend = InBackend;
+}
+
+ESRRecognizerBackend USymbolRecognizer::GetRecognizerBackend() const
+{
+	return RecognizerBackend;
+}
+
+const ISRRecognizerBackend& USymbolRecognizer::GetActiveBackend() const
+{
+	if (RecognizerBackend == ESRRecognizerBackend::PointCloud && PointCloudRecognizer.IsReady())
+	{
+		return PointCloudRecognizer;
+	}
+
+	return NetworkBackend;
+}
+
+bool USymbolRecognizer::IsBackendReady(ESRRecognizerBackend InBackend) const
+{
+	switch (InBackend)
+	{
+	case ESRRecognizerBackend::PointCloud:
+		return PointCloudRecognizer.IsReady();
+	default:
+		return NetworkBackend.IsReady();
+	}
 }
 
 class USRCanvasHandler* USymbolRecognizer::GetCanvasHandler() const
@@ -193,6 +429,9 @@ void USymbolRecognizer::ClearCanvas()
 
 FSRNeuralNetwork& USymbolRecognizer::GetNeuralNetworkRef(bool bTryLoad)
 {
+	//caller may change weights.
+	bLiveQueryDirty = true;
+
 	if (bIsLoaded)
 	{
 		return NeuralNetwork;
@@ -201,6 +440,7 @@ FSRNeuralNetwork& USymbolRecognizer::GetNeuralNetworkRef(bool bTryLoad)
 	if (bTryLoad)
 	{
 		LoadNeuralNetworkFromSRData(NeuralNetwork);
+		LoadProfileModels();
 		bIsLoaded = true;
 	}
 	
@@ -208,9 +448,341 @@ FSRNeuralNetwork& USymbolRecognizer::GetNeuralNetworkRef(bool bTryLoad)
 }
 
 
+float USymbolRecognizer::BuildQuantizedNetwork(const TArray<TArray<float>>& CalibrationInputs)
+{
+	FSRProfileModels& Models = SRData->ProfileModels.FindOrAdd(GetCurrentProfile());
+
+	if (!Models.QuantizedNetwork.Build(NeuralNetwork, CalibrationInputs))
+	{
+		Models.QuantizedNetwork = FSRQuantizedNetwork();
+		QuantizedNetwork = FSRQuantizedNetwork();
+		return -1.0f;
+	}
+
+	QuantizedNetwork = Models.QuantizedNetwork;
+	return QuantizedNetwork.AgreementRate;
+}
+
+void USymbolRecognizer::SetUseQuantizedNetwork(bool bInUseQuantizedNetwork)
+{
+	bUseQuantizedNetwork = bInUseQuantizedNetwork;
+}
+
+bool USymbolRecognizer::IsUsingQuantizedNetwork() const
+{
+	return GetActiveModelVariant() == ESRModelVariant::Quantized;
+}
+
+float USymbolRecognizer::BuildPrunedNetwork(const TArray<TArray<float>>& CalibrationInputs, float InRemovedRatio)
+{
+	FSRNeuralNetwork Pruned;
+	const float AgreementRate = MakePrunedNetwork(NeuralNetwork, CalibrationInputs, InRemovedRatio, Pruned);
+	SavePrunedNetwork(Pruned, AgreementRate);
+	return AgreementRate;
+}
+
+float USymbolRecognizer::MakePrunedNetwork(const FSRNeuralNetwork& InNetwork, const TArray<TArray<float>>& CalibrationInputs, float InRemovedRatio, FSRNeuralNetwork& OutPruned)
+{
+	OutPruned = InNetwork.MakePruned(FMath::Max(1, FMath::RoundToInt(InNetwork.HiddenNodes * (1.0f - InRemovedRatio))));
+	if (!OutPruned.bIsTrained)
+	{
+		return -1.0f;
+	}
+
+	if (CalibrationInputs.Num() == 0)
+	{
+		return 0.0f;
+	}
+
+	//output layer learns to answer like the full network on training images.
+	TArray<float> Targets;
+	for (int32 Epoch = 0; Epoch < 5; ++Epoch)
+	{
+		for (const TArray<float>& Input : CalibrationInputs)
+		{
+			FSRDMatrix FullResult = InNetwork.Query(Input);
+			Targets.Reset(FullResult.R.Num());
+			for (const auto& Row : FullResult.R)
+			{
+				Targets.Add(Row.C[0]);
+			}
+			OutPruned.TrainOutputLayer(Input, Targets);
+		}
+	}
+
+	int32 Agreed = 0;
+	for (const TArray<float>& Input : CalibrationInputs)
+	{
+		int32 FullBest, PrunedBest;
+		FSRNeuralNetwork::GetTopTwoMargin(InNetwork.Query(Input), FullBest);
+		FSRNeuralNetwork::GetTopTwoMargin(OutPruned.Query(Input), PrunedBest);
+		Agreed += (FullBest == PrunedBest) ? 1 : 0;
+	}
+	return Agreed / (float)CalibrationInputs.Num();
+}
+
+void USymbolRecognizer::SavePrunedNetwork(const FSRNeuralNetwork& InPruned, float InAgreementRate)
+{
+	FSRProfileModels& Models = SRData->ProfileModels.FindOrAdd(GetCurrentProfile());
+	Models.PrunedNetwork = InPruned;
+	Models.PrunedAgreementRate = FMath::Max(0.0f, InAgreementRate);
+
+	PrunedNetwork = Models.PrunedNetwork;
+	PrunedAgreementRate = Models.PrunedAgreementRate;
+}
+
+bool USymbolRecognizer::IsModelVariantAvailable(ESRModelVariant InVariant) const
+{
+	switch (InVariant)
+	{
+	case ESRModelVariant::Pruned:
+		return PrunedNetwork.bIsTrained && PrunedNetwork.InputNodes == NeuralNetwork.InputNodes && PrunedNetwork.OutputNodes == NeuralNetwork.OutputNodes
+			&& PrunedNetwork.InputEncoding == NeuralNetwork.InputEncoding;
+	case ESRModelVariant::Quantized:
+		return QuantizedNetwork.IsCompatibleWith(NeuralNetwork);
+	default:
+		return true;
+	}
+}
+
+ESRModelVariant USymbolRecognizer::GetActiveModelVariant() const
+{
+	const int32 ForcedVariant = CVarSRModelVariant.GetValueOnAnyThread();
+	if (ForcedVariant >= 0 && ForcedVariant <= (int32)ESRModelVariant::Quantized && IsModelVariantAvailable((ESRModelVariant)ForcedVariant))
+	{
+		return (ESRModelVariant)ForcedVariant;
+	}
+
+	if (bSelectModelByLatency)
+	{
+		return IsModelVariantAvailable(BenchmarkedVariant) ? BenchmarkedVariant : ESRModelVariant::Full;
+	}
+
+	return (bUseQuantizedNetwork && IsModelVariantAvailable(ESRModelVariant::Quantized)) ? ESRModelVariant::Quantized : ESRModelVariant::Full;
+}
+
+ESRModelVariant USymbolRecognizer::SelectModelVariantByLatency()
+{
+	BenchmarkedVariant = ESRModelVariant::Full;
+	if (!NeuralNetwork.bIsTrained)
+	{
+		return BenchmarkedVariant;
+	}
+
+	TArray<float> BenchmarkInput;
+	BenchmarkInput.Init(0.5f, NeuralNetwork.InputNodes);
+
+	const float AgreementRates[] = { 1.0f, PrunedAgreementRate, QuantizedNetwork.AgreementRate };
+	double FastestTime = MAX_dbl;
+	ESRModelVariant FastestVariant = ESRModelVariant::Full;
+	float BestAgreement = -1.0f;
+
+	for (int32 Variant = 0; Variant <= (int32)ESRModelVariant::Quantized; ++Variant)
+	{
+		if (!IsModelVariantAvailable((ESRModelVariant)Variant))
+		{
+			continue;
+		}
+
+		//first query warms caches up, the best of the rest is taken.
+		QueryModelVariant((ESRModelVariant)Variant, BenchmarkInput, nullptr);
+		double BestTime = MAX_dbl;
+		for (int32 Run = 0; Run < 5; ++Run)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			QueryModelVariant((ESRModelVariant)Variant, BenchmarkInput, nullptr);
+			BestTime = FMath::Min(BestTime, FPlatformTime::Seconds() - StartTime);
+		}
+
+		const double Microseconds = BestTime * 1e6;
+		UE_LOG(LogTemp, Log, TEXT("Model variant %i: %.1f us, agreement with full model: %.2f%%"), Variant, Microseconds, AgreementRates[Variant] * 100.0f);
+
+		if (Microseconds < FastestTime)
+		{
+			FastestTime = Microseconds;
+			FastestVariant = (ESRModelVariant)Variant;
+		}
+
+		if (Microseconds <= RecognitionBudgetMicroseconds && AgreementRates[Variant] > BestAgreement)
+		{
+			BestAgreement = AgreementRates[Variant];
+			BenchmarkedVariant = (ESRModelVariant)Variant;
+		}
+	}
+
+	if (BestAgreement < 0.0f)
+	{
+		BenchmarkedVariant = FastestVariant;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Selected model variant %i for profile %s (budget %.1f us)."), (int32)BenchmarkedVariant, *GetCurrentProfile(), RecognitionBudgetMicroseconds);
+	return BenchmarkedVariant;
+}
+
+FSRNeuralNetwork& USymbolRecognizer::GetCascadeNetworkRef()
+{
+	return CascadeNetwork;
+}
+
+void USymbolRecognizer::SaveCascadeNetwork(bool bInEnabled, float InExitMargin)
+{
+	FSRProfileModels& Models = SRData->ProfileModels.FindOrAdd(GetCurrentProfile());
+
+	if (bInEnabled && CascadeNetwork.bIsTrained)
+	{
+		Models.CascadeNetwork = CascadeNetwork;
+		Models.CascadeExitMargin = InExitMargin;
+		CascadeExitMargin = InExitMargin;
+	}
+	else
+	{
+		Models.CascadeNetwork = FSRNeuralNetwork();
+	}
+}
+
+float USymbolRecognizer::GetCascadeEarlyExitRate() const
+{
+	return CascadeQueries > 0 ? CascadeEarlyExits / (float)CascadeQueries : 0.0f;
+}
+
+void USymbolRecognizer::LogCascadeEarlyExitRate() const
+{
+	if (CascadeQueries > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Cascade early exit rate: %.2f%% of %i queries (exit margin %.2f)."), GetCascadeEarlyExitRate() * 100.0f, CascadeQueries, CascadeExitMargin);
+	}
+}
+
+void USymbolRecognizer::SaveProfileBackend(ESRRecognizerBackend InBackend, bool bInRotationInvariant)
+{
+	FSRProfileModels& Models = SRData->ProfileModels.FindOrAdd(GetCurrentProfile());
+	Models.Backend = InBackend;
+	Models.bPointCloudRotationInvariant = bInRotationInvariant;
+	RecognizerBackend = InBackend;
+	RefreshPointCloudTemplates();
+}
+
+void USymbolRecognizer::SaveTrainingHash(uint32 InHash)
+{
+	SRData->ProfileModels.FindOrAdd(GetCurrentProfile()).TrainingHash = InHash;
+}
+
+uint32 USymbolRecognizer::GetTrainingHash() const
+{
+	const FSRProfileModels* Models = SRData->ProfileModels.Find(GetCurrentProfile());
+	return Models ? Models->TrainingHash : 0;
+}
+
+void USymbolRecognizer::SaveStrokeSample(const FSRStrokeSample& InSample)
+{
+	FSRProfileModels& Models = SRData->ProfileModels.FindOrAdd(GetCurrentProfile());
+	if (FSRStrokeSample* ExistingSample = Models.FindStrokeSample(InSample.SymbolId, InSample.ImageId))
+	{
+		*ExistingSample = InSample;
+	}
+	else
+	{
+		Models.StrokeSamples.Add(InSample);
+	}
+
+	RefreshPointCloudTemplates();
+}
+
+bool USymbolRecognizer::GetStrokeSample(int32 InSymbolId, int32 InImageId, FSRStrokeSample& OutSample) const
+{
+	if (FSRProfileModels* Models = SRData->ProfileModels.Find(GetCurrentProfile()))
+	{
+		if (FSRStrokeSample* Sample = Models->FindStrokeSample(InSymbolId, InImageId))
+		{
+			OutSample = *Sample;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void USymbolRecognizer::RemoveStrokeSample(int32 InSymbolId, int32 InImageId)
+{
+	if (FSRProfileModels* Models = SRData->ProfileModels.Find(GetCurrentProfile()))
+	{
+		Models->StrokeSamples.RemoveAll([&](const FSRStrokeSample& Sample) { return Sample.SymbolId == InSymbolId && Sample.ImageId == InImageId; });
+		RefreshPointCloudTemplates();
+	}
+}
+
+bool USymbolRecognizer::HasStrokeSample(int32 InSymbolId, int32 InImageId) const
+{
+	if (FSRProfileModels* Models = SRData->ProfileModels.Find(GetCurrentProfile()))
+	{
+		return Models->FindStrokeSample(InSymbolId, InImageId) != nullptr;
+	}
+
+	return false;
+}
+
+void USymbolRecognizer::RemoveStrokeSamplesOutOfRange(int32 InSymbolsAmount, int32 InImagesPerSymbol)
+{
+	if (FSRProfileModels* Models = SRData->ProfileModels.Find(GetCurrentProfile()))
+	{
+		Models->StrokeSamples.RemoveAll([&](const FSRStrokeSample& Sample) { return Sample.SymbolId >= InSymbolsAmount || Sample.ImageId >= InImagesPerSymbol; });
+	}
+}
+
+void USymbolRecognizer::RefreshPointCloudTemplates()
+{
+	if (FSRProfileModels* Models = SRData->ProfileModels.Find(GetCurrentProfile()))
+	{
+		PointCloudRecognizer.SetTemplates(Models->StrokeSamples, 0, Models->bPointCloudRotationInvariant);
+	}
+	else
+	{
+		PointCloudRecognizer.Reset();
+	}
+}
+
+void USymbolRecognizer::SaveSharedTrunk(FName InName, FSRNeuralNetwork& InNetwork)
+{
+	FSRSharedTrunk& Trunk = SRData->SharedTrunks.FindOrAdd(InName);
+	Trunk.wih = InNetwork.wih;
+	Trunk.InputNodes = InNetwork.InputNodes;
+	Trunk.HiddenNodes = InNetwork.HiddenNodes;
+	Trunk.HiddenActivation = InNetwork.HiddenActivation;
+	Trunk.InputEncoding = InNetwork.InputEncoding;
+	Trunk.Revision++;
+
+	InNetwork.SharedTrunk = InName;
+	InNetwork.SharedTrunkRevision = Trunk.Revision;
+}
+
+const FSRSharedTrunk* USymbolRecognizer::FindSharedTrunk(FName InName) const
+{
+	return SRData->SharedTrunks.Find(InName);
+}
+
+void USymbolRecognizer::ClearQuantizedNetwork()
+{
+	SRData->ProfileModels.FindOrAdd(GetCurrentProfile()).QuantizedNetwork = FSRQuantizedNetwork();
+	QuantizedNetwork = FSRQuantizedNetwork();
+}
+
+void USymbolRecognizer::ClearPrunedNetwork()
+{
+	FSRProfileModels& Models = SRData->ProfileModels.FindOrAdd(GetCurrentProfile());
+	Models.PrunedNetwork = FSRNeuralNetwork();
+	Models.PrunedAgreementRate = 0.0f;
+	PrunedNetwork = FSRNeuralNetwork();
+	PrunedAgreementRate = 0.0f;
+}
+
 void USymbolRecognizer::SaveNeuralProfile(const FString InProfile, FSRNeuralNetwork& InNeuralNetwork)
 {
-	SRData->NeuralProfiles.Add(InProfile, InNeuralNetwork);
+	FSRNeuralNetwork& SavedNeural = SRData->NeuralProfiles.Add(InProfile, InNeuralNetwork);
+	if (SavedNeural.UsesSharedTrunk())
+	{
+		//hidden layer lives in SharedTrunks.
+		SavedNeural.wih = FSRDMatrix(0, 0, 0);
+	}
 	SelectProfile(InProfile, false, true);
 }
 
@@ -223,24 +795,194 @@ bool USymbolRecognizer::LoadNeuralNetworkFromSRData(FSRNeuralNetwork& NeuralData
 {
 	if (FSRNeuralNetwork* SavedNeural = SRData->NeuralProfiles.Find(GetCurrentProfile()))
 	{
+		if (!SavedNeural->UsesSharedTrunk())
+		{
+			NeuralData = *SavedNeural;
+			return true;
+		}
+
+		//keep trunk that is already loaded, so switching between profiles of one trunk copies only the output layer.
+		FSRDMatrix TrunkWeights = FSRDMatrix(0, 0, 0);
+		const FSRSharedTrunk* Trunk = SRData->SharedTrunks.Find(SavedNeural->SharedTrunk);
+		if (NeuralData.SharedTrunk == SavedNeural->SharedTrunk && NeuralData.SharedTrunkRevision == SavedNeural->SharedTrunkRevision
+			&& NeuralData.wih.NumRows == SavedNeural->HiddenNodes && NeuralData.wih.NumColumns == SavedNeural->InputNodes)
+		{
+			TrunkWeights = MoveTemp(NeuralData.wih);
+		}
+		else if (Trunk && Trunk->Revision == SavedNeural->SharedTrunkRevision && Trunk->IsCompatibleWith(*SavedNeural))
+		{
+			TrunkWeights = Trunk->wih;
+		}
+
 		NeuralData = *SavedNeural;
+		if (TrunkWeights.NumRows == 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Shared trunk %s is missing or was trained again, profile %s must be trained again."), *SavedNeural->SharedTrunk.ToString(), *GetCurrentProfile());
+			NeuralData.bIsTrained = false;
+			return true;
+		}
+
+		NeuralData.wih = MoveTemp(TrunkWeights);
 		return true;
 	}
 
 	return false;
 }
 
+void USymbolRecognizer::LoadProfileModels()
+{
+	//counters of the previous models are reset below.
+	LogCascadeEarlyExitRate();
+
+	if (FSRProfileModels* SavedModels = SRData->ProfileModels.Find(GetCurrentProfile()))
+	{
+		QuantizedNetwork = SavedModels->QuantizedNetwork;
+		CascadeNetwork = SavedModels->CascadeNetwork;
+		PrunedNetwork = SavedModels->PrunedNetwork;
+		PrunedAgreementRate = SavedModels->PrunedAgreementRate;
+		CascadeExitMargin = SavedModels->CascadeExitMargin;
+		RecognizerBackend = SavedModels->Backend;
+	}
+	else
+	{
+		QuantizedNetwork = FSRQuantizedNetwork();
+		CascadeNetwork = FSRNeuralNetwork();
+		PrunedNetwork = FSRNeuralNetwork();
+		PrunedAgreementRate = 0.0f;
+		RecognizerBackend = ESRRecognizerBackend::NeuralNetwork;
+	}
+	RefreshPointCloudTemplates();
+	LoadPlayerAdaptation();
+	if (bSelectModelByLatency)
+	{
+		SelectModelVariantByLatency();
+	}
+	bLiveQueryDirty = true;
+
+	CascadeQueries = 0;
+	CascadeEarlyExits = 0;
+}
+
+
+void USymbolRecognizer::LoadPlayerAdaptation()
+{
+	if (!bEnablePlayerAdaptation)
+	{
+		PlayerAdaptation.Reset(nullptr, nullptr);
+		return;
+	}
+
+	if (PlayerAdaptationSave == nullptr && UGameplayStatics::DoesSaveGameExist(AdaptationSaveSlot, AdaptationUserIndex))
+	{
+		PlayerAdaptationSave = Cast<USRPlayerAdaptationSave>(UGameplayStatics::LoadGameFromSlot(AdaptationSaveSlot, AdaptationUserIndex));
+	}
+
+	const FSROutputLayerDelta* SavedDelta = PlayerAdaptationSave ? PlayerAdaptationSave->Profiles.Find(GetCurrentProfile()) : nullptr;
+	PlayerAdaptation.Reset(&NeuralNetwork, SavedDelta);
+}
+
+const FSRNeuralNetwork& USymbolRecognizer::GetRecognitionNetwork(const FSRDMatrix*& OutOutputLayer) const
+{
+	OutOutputLayer = nullptr;
+	if (PreviewNetwork.IsValid())
+	{
+		return *PreviewNetwork;
+	}
+
+	if (IsUsingPlayerAdaptation())
+	{
+		OutOutputLayer = &PlayerAdaptation.GetOutputLayer();
+		return PlayerAdaptation.GetBaseNetwork();
+	}
+
+	return NeuralNetwork;
+}
+
+void USymbolRecognizer::ConfirmSymbol(int32 SymbolId)
+{
+	if (!IsUsingPlayerAdaptation() || GetCanvasHandler()->GetDrawLinesRef().Num() == 0)
+	{
+		return;
+	}
+
+	TArray<float> InputData;
+	if (NeuralNetwork.InputEncoding == ESRInputEncoding::StrokeDirections)
+	{
+		FSRStrokeEncoder::Encode(GetCanvasHandler()->GetDrawLinesRef(), InputData);
+	}
+	else
+	{
+		GetCanvasHandler()->GetDataFromTexture(InputData);
+	}
+
+	PlayerAdaptation.AddConfirmedSample(InputData, SymbolId);
+}
+
+bool USymbolRecognizer::UpdatePlayerAdaptation(float BudgetMicroseconds)
+{
+	if (!IsUsingPlayerAdaptation())
+	{
+		return false;
+	}
+
+	PlayerAdaptation.Tick(BudgetMicroseconds * 1e-6);
+	return PlayerAdaptation.HasPendingSteps();
+}
+
+bool USymbolRecognizer::SavePlayerAdaptation()
+{
+	if (!IsUsingPlayerAdaptation())
+	{
+		return false;
+	}
+
+	if (PlayerAdaptationSave == nullptr)
+	{
+		PlayerAdaptationSave = Cast<USRPlayerAdaptationSave>(UGameplayStatics::CreateSaveGameObject(USRPlayerAdaptationSave::StaticClass()));
+	}
+
+	FSROutputLayerDelta& SavedDelta = PlayerAdaptationSave->Profiles.FindOrAdd(GetCurrentProfile());
+	PlayerAdaptation.GetDelta(SavedDelta);
+	return UGameplayStatics::SaveGameToSlot(PlayerAdaptationSave, AdaptationSaveSlot, AdaptationUserIndex);
+}
+
+void USymbolRecognizer::ResetPlayerAdaptation()
+{
+	if (PlayerAdaptationSave)
+	{
+		PlayerAdaptationSave->Profiles.Remove(GetCurrentProfile());
+	}
+	LoadPlayerAdaptation();
+	bLiveQueryDirty = true;
+}
+
+void USymbolRecognizer::SetPlayerAdaptationEnabled(bool bInEnabled)
+{
+	if (bEnablePlayerAdaptation != bInEnabled)
+	{
+		bEnablePlayerAdaptation = bInEnabled;
+		LoadPlayerAdaptation();
+		bLiveQueryDirty = true;
+	}
+}
+
+bool USymbolRecognizer::IsUsingPlayerAdaptation() const
+{
+	return bEnablePlayerAdaptation && PlayerAdaptation.IsActive();
+}
 
 bool USymbolRecognizer::SelectProfile(const FString InProfile, bool bAddEmptyIfNotFound, bool bShouldSave)
 {
 	if (SRData->NeuralProfiles.Contains(InProfile))
 	{
 		SRData->CurrentProfile = InProfile;
+		PreviewNetwork.Reset();
 
 		if (LoadNeuralNetworkFromSRData(NeuralNetwork) == false)
 		{
 			NeuralNetwork = FSRNeuralNetwork();
 		}
+		LoadProfileModels();
 
 		if (bShouldSave)
 		{
@@ -258,6 +1000,38 @@ bool USymbolRecognizer::SelectProfile(const FString InProfile, bool bAddEmptyIfN
 }
 
 
+void USymbolRecognizer::SetNetworkMailbox(const FString& InProfile, const TSharedPtr<FSRNetworkMailbox, ESPMode::ThreadSafe>& InMailbox)
+{
+	if (InMailbox.IsValid())
+	{
+		NetworkMailboxes.Add(InProfile, InMailbox);
+		return;
+	}
+
+	NetworkMailboxes.Remove(InProfile);
+	if (InProfile == GetCurrentProfile() && PreviewNetwork.IsValid())
+	{
+		PreviewNetwork.Reset();
+		bLiveQueryDirty = true;
+	}
+}
+
+void USymbolRecognizer::ConsumePublishedNetwork() const
+{
+	const TSharedPtr<FSRNetworkMailbox, ESPMode::ThreadSafe>* Mailbox = NetworkMailboxes.Num() > 0 ? NetworkMailboxes.Find(GetCurrentProfile()) : nullptr;
+	if (Mailbox == nullptr)
+	{
+		return;
+	}
+
+	if (TUniquePtr<FSRNeuralNetwork> Published = (*Mailbox)->Consume())
+	{
+		//LiveQuery points to the replaced network.
+		PreviewNetwork = MoveTemp(Published);
+		bLiveQueryDirty = true;
+	}
+}
+
 void USymbolRecognizer::SaveSRData()
 {
 	if (SRDataPackage == nullptr)
@@ -304,6 +1078,7 @@ void USymbolRecognizer::LoadSRData()
 bool USymbolRecognizer::DeleteProfile(const FString InProfile)
 {
 	SRData->DrawLayers.Remove(InProfile);
+	SRData->ProfileModels.Remove(InProfile);
 	return SRData->NeuralProfiles.Remove(InProfile) > 0;
 }
 
@@ -92,6 +92,8 @@ public:
 	FORCEINLINE TArray<FSRDrawLine> GetDrawLines() const { return DrawLines; };
 	FORCEINLINE const TArray<FSRDrawLine>& GetDrawLinesRef() const { return DrawLines; };
 	FORCEINLINE FIntPoint GetLastActiveDrawCell() const { return DrawPointsHelper.CurrentCell; }
+	//changes every time a point is added or canvas is cleared.
+	FORCEINLINE uint32 GetDrawRevision() const { return DrawRevision; }
 	void GetTextureDrawData(TArray<FSRDrawLine>& OutDrawLines, FVector2D& OutSymbolPosition, FVector2D& OutSymbolSize, FVector2D& OutSymbolCenter, FVector2D& OutScaledSymbolSize);
 	void GetDrawPointsFromLines(TArray<FVector2D>& OutDrawPoints, float GapSubStepMultiplier = 0.25f) const;
 	float GetScaledBrushSize() const;
@@ -114,6 +116,7 @@ private:
 	FMargin SymbolMaxima;
 
 	TArray<FSRDrawLine> DrawLines;
+	uint32 DrawRevision = 0;
 	FVector2D BrushPosition;
 	FSRDrawPointsHelper DrawPointsHelper;
 
@@ -0,0 +1,48 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#pragma once
+#include "SRNeuralNetwork.h"
+
+/*
+ * Keeps hidden layer sums of the last queried input, so the next query only adds weights of inputs that changed.
+ * Meant for live recognition while drawing: between two frames only a few pixels (or descriptor cells) change.
+ * Sums are fully recomputed every RefreshInterval updates or when too many inputs changed at once (canvas rescaled),
+ * which also bounds float drift of the accumulated sums.
+ */
+class SYMBOLRECOGNIZERPLUGIN_API FSRIncrementalQuery
+{
+public:
+	static const int32 RefreshInterval = 64;
+	//fraction of changed inputs above which full recompute is cheaper.
+	static constexpr float MaxChangedInputsRatio = 0.25f;
+
+	/*
+	* Network must outlive this object (or Reset must be called with a new one).
+	* @ InOutputLayer used instead of network's who when set (see FSRNeuralNetwork::QueryOutputLayer), must outlive this object too.
+	*/
+	void Reset(const FSRNeuralNetwork* InNetwork, const FSRDMatrix* InOutputLayer = nullptr);
+	//next Update does a full recompute.
+	FORCEINLINE void Invalidate() { bHasState = false; }
+	FORCEINLINE bool IsValid() const { return Network != nullptr && Network->bIsTrained; }
+
+	/*
+	* @ return output of the network for InInputList (same as FSRNeuralNetwork::Query).
+	*/
+	FSRDMatrix Update(const TArray<float>& InInputList, const TBitArray<>* AllowedOutputs = nullptr);
+
+	FORCEINLINE int32 GetLastChangedInputs() const { return LastChangedInputs; }
+
+private:
+	const FSRNeuralNetwork* Network = nullptr;
+	const FSRDMatrix* OutputLayer = nullptr;
+	//wih transposed, row per input so changed input touches contiguous memory.
+	TArray<float> WeightsByInput;
+	TArray<float> PreviousInput;
+	TArray<float> HiddenSums;
+	TArray<float, TInlineAllocator<128>> HiddenOutputs;
+	int32 UpdatesSinceRefresh = 0;
+	int32 LastChangedInputs = 0;
+	bool bHasState = false;
+
+	void FullRecompute(const TArray<float>& InInputList);
+};
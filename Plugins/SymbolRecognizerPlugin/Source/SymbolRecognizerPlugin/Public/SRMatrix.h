@@ -79,6 +79,10 @@ public:
 	FSRDMatrix CompWiseMultiply(const FSRDMatrix& Other);
 	FSRDMatrix CompWiseOperation(const FMatrixCompWiseOperation& Operation);
 	FSRDMatrix ActivationOperation(EActivationFunc InActivationFunc);
+	/*
+	* Derivative of the activation function calculated from already activated values.
+	*/
+	FSRDMatrix ActivationDerivativeOperation(EActivationFunc InActivationFunc);
 	FSRDMatrix ToSoftMax();
 
 	void SetOrCreate(uint32 row, uint32 col, float InValue);
@@ -99,4 +103,20 @@ public:
 	{
 		return 2.0f * SigmoidFunc(2.0f * Z) - 1.0f;
 	}
+
+	//derivatives take activated value (Y = Func(Z)), not Z.
+	FORCEINLINE float SigmoidDerivativeFunc(const float& Y) const
+	{
+		return Y * (1.0f - Y);
+	}
+
+	FORCEINLINE float ReLUDerivativeFunc(const float& Y) const
+	{
+		return Y > 0.0f ? 1.0f : 0.001f;
+	}
+
+	FORCEINLINE float TanHDerivativeFunc(const float& Y) const
+	{
+		return 1.0f - Y * Y;
+	}
 };
@@ -0,0 +1,27 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#pragma once
+#include "SRNeuralNetwork.h"
+
+/*
+ * Single slot handing networks from a training thread to the recognizer without locks.
+ * Producer swaps a new network in (the previous one, if nobody took it, is deleted), consumer swaps the slot out.
+ * Any number of producers, one consumer (game thread).
+ */
+class SYMBOLRECOGNIZERPLUGIN_API FSRNetworkMailbox
+{
+public:
+	FSRNetworkMailbox() = default;
+	FSRNetworkMailbox(const FSRNetworkMailbox&) = delete;
+	FSRNetworkMailbox& operator=(const FSRNetworkMailbox&) = delete;
+	~FSRNetworkMailbox();
+
+	void Publish(const FSRNeuralNetwork& InNetwork);
+	/*
+	* @ return the latest published network (nullptr when nothing new was published since the last call).
+	*/
+	TUniquePtr<FSRNeuralNetwork> Consume();
+
+private:
+	FSRNeuralNetwork* volatile Pending = nullptr;
+};
@@ -4,6 +4,48 @@
 #include "SRMatrix.h"
 #include "SRNeuralNetwork.generated.h"
 
+/*
+ * Mirrors FSRDMatrix::EActivationFunc so it can be stored and edited.
+ */
+UENUM(BlueprintType)
+enum class ESRActivationFunc : uint8
+{
+	Sigmoid = 0,
+	ReLU,
+	TanH
+};
+
+/*
+ * Data the network was trained on.
+ */
+UENUM(BlueprintType)
+enum class ESRInputEncoding : uint8
+{
+	//Luminance of every pixel of the canvas texture.
+	Pixels = 0,
+	//Strokes orientations histogram per cell, see FSRStrokeEncoder.
+	StrokeDirections
+};
+
+/*
+ * Weights updates of many samples summed up (laid out like wih and who rows), used by parallel training.
+ */
+struct SYMBOLRECOGNIZERPLUGIN_API FSRGradientBuffer
+{
+	TArray<float> wih;
+	TArray<float> who;
+	int32 SamplesCount = 0;
+
+	void Init(const struct FSRNeuralNetwork& InNetwork);
+	void Reset();
+	FORCEINLINE int32 Num() const { return wih.Num() + who.Num(); }
+	/*
+	* Adds values of InOther in range [InStart, InEnd) of wih followed by who (so reduction can be split between threads).
+	* SamplesCount is not changed.
+	*/
+	void Add(const FSRGradientBuffer& InOther, int32 InStart, int32 InEnd);
+};
+
 USTRUCT()
 struct SYMBOLRECOGNIZERPLUGIN_API FSRNeuralNetwork
 {
@@ -24,12 +66,107 @@ struct SYMBOLRECOGNIZERPLUGIN_API FSRNeuralNetwork
 		FSRDMatrix who = FSRDMatrix(0, 0, 0);
 	UPROPERTY()
 		bool bIsTrained = false;
+	UPROPERTY()
+		ESRActivationFunc HiddenActivation = ESRActivationFunc::Sigmoid;
+	UPROPERTY()
+		ESRActivationFunc OutputActivation = ESRActivationFunc::Sigmoid;
+	UPROPERTY()
+		ESRInputEncoding InputEncoding = ESRInputEncoding::Pixels;
+	/*
+	* Symbols per group of the two-level classifier, 0 means flat output layer.
+	* When used, who picks a group and GroupHeads[group] picks the symbol (both read the same hidden layer).
+	*/
+	UPROPERTY()
+		uint32 GroupSize = 0;
+	UPROPERTY()
+		TArray<FSRDMatrix> GroupHeads;
+	/*
+	* Name of the hidden layer shared with other profiles (USymbolRecognizerData::SharedTrunks), None when wih is stored here.
+	*/
+	UPROPERTY()
+		FName SharedTrunk;
+	UPROPERTY()
+		uint32 SharedTrunkRevision = 0;
+	/*
+	* Seed of initial weights (also used by InitializeGroups and MakeUntrained), the same seed gives the same weights.
+	*/
+	UPROPERTY()
+		int32 RandomSeed = 0;
 	
 	FSRNeuralNetwork() {};
-	FSRNeuralNetwork(uint32 InInputNodes, uint32 InHiddenNodes, uint32 InOutputNodes, float InLearningRate);
+	FSRNeuralNetwork(uint32 InInputNodes, uint32 InHiddenNodes, uint32 InOutputNodes, float InLearningRate,
+		ESRActivationFunc InHiddenActivation = ESRActivationFunc::Sigmoid, ESRActivationFunc InOutputActivation = ESRActivationFunc::Sigmoid, int32 InRandomSeed = 0);
 
+	/*
+	* Single sample SGD step. Forward pass, deltas and weights update are fused into a few passes over wih/who rows,
+	* results are identical to TrainMatrix.
+	*/
 	void Train(const TArray<float>& InputList, const TArray<float>& OutputList);
+	/*
+	* Splits outputs into groups of InGroupSize symbols (see GroupSize). Resets output weights.
+	*/
+	void InitializeGroups(uint32 InGroupSize);
+	/*
+	* @ return network with the same layout and settings but new random weights.
+	*/
+	FSRNeuralNetwork MakeUntrained(uint32 InHiddenNodes) const;
+	/*
+	* Copy with only InKeepHiddenNodes most important hidden nodes (by weights magnitude), flat networks only.
+	* @ return untrained network when pruning is not possible.
+	*/
+	FSRNeuralNetwork MakePruned(uint32 InKeepHiddenNodes) const;
+	FORCEINLINE bool UsesSharedTrunk() const { return !SharedTrunk.IsNone(); }
+	FORCEINLINE bool IsHierarchical() const { return GroupSize > 0 && GroupHeads.Num() > 0; }
+	FORCEINLINE uint32 GetGroupsCount() const { return GroupSize > 0 ? (OutputNodes + GroupSize - 1) / GroupSize : 0; }
+	/*
+	* Floating point operations of one Query (multiply and add counted separately, activations not counted).
+	* Two-level output layer evaluates the group layer and a single group head.
+	*/
+	int64 GetInferenceFlops() const;
+	/*
+	* Checksum of all weights, equal checksums of two trainings mean bit-identical networks.
+	*/
+	uint32 GetWeightsCrc() const;
+	/*
+	* Same step written with generic matrix operations, used when input data size doesn't match the network.
+	*/
+	void TrainMatrix(const TArray<float>& InputList, const TArray<float>& OutputList);
+	/*
+	* SGD step of the output layer only, wih stays as it is (e.g. head trained on top of a shared trunk).
+	* Two-level output layers are not supported.
+	*/
+	void TrainOutputLayer(const TArray<float>& InputList, const TArray<float>& OutputList);
+	/*
+	* Same step as Train but weights updates (without learning rate) are added to OutGradients and weights are not changed.
+	* Two-level output layers are not supported.
+	*/
+	void AccumulateGradients(const TArray<float>& InputList, const TArray<float>& OutputList, FSRGradientBuffer& OutGradients, bool bOutputLayerOnly = false) const;
+	/*
+	* Adds InGradients multiplied by InScale to weights.
+	*/
+	void ApplyGradients(const FSRGradientBuffer& InGradients, float InScale, bool bOutputLayerOnly = false);
 	FSRDMatrix Query(const TArray<float>& InputList) const;
+	/*
+	* Evaluates only output rows allowed by AllowedOutputs (nullptr allows all), other rows are 0.
+	*/
+	FSRDMatrix Query(const TArray<float>& InputList, const TBitArray<>* AllowedOutputs) const;
+	/*
+	* Output layer only (flat or two-level), HiddenOutputs must hold HiddenNodes already activated values.
+	*/
+	FSRDMatrix QueryFromHidden(const float* HiddenOutputs, const TBitArray<>* AllowedOutputs = nullptr) const;
+	/*
+	* Flat output layer with InWho used instead of who (e.g. output layer adapted to player, see FSRPlayerAdaptation).
+	*/
+	FSRDMatrix QueryOutputLayer(const FSRDMatrix& InWho, const float* HiddenOutputs, const TBitArray<>* AllowedOutputs = nullptr) const;
+	/*
+	* Activated hidden layer for Inputs (InputNodes values).
+	*/
+	void ForwardHidden(const float* Inputs, TArray<float, TInlineAllocator<128>>& OutHiddenOutputs) const;
+
+	static FORCEINLINE bool IsOutputAllowed(const TBitArray<>* AllowedOutputs, int32 OutputIdx)
+	{
+		return AllowedOutputs == nullptr || (OutputIdx < AllowedOutputs->Num() && (*AllowedOutputs)[OutputIdx]);
+	}
 
 	/*
 	* @ Neural Item to verify.
@@ -40,6 +177,60 @@ struct SYMBOLRECOGNIZERPLUGIN_API FSRNeuralNetwork
 	* @ return 1 when answer found or 0 otherwise.
 	*/
 	static int32 GetQueryResult(const FSRNeuralNetwork& Neural, const TArray<float>& QueryData, int32 AnswerIdx, float AcceptableAsnwerSize = 0.5, float DeltaBestAnswers = 0.97);
+	/*
+	* The same check on output already returned by Query.
+	*/
+	static int32 GetQueryResult(const FSRDMatrix& Result, int32 AnswerIdx, float AcceptableAsnwerSize = 0.5, float DeltaBestAnswers = 0.97);
+
+	/*
+	* @ Result output of Query.
+	* @ OutBestIdx index of the best answer (-1 if there is none).
+	* @ return difference between two best answers.
+	*/
+	static float GetTopTwoMargin(const FSRDMatrix& Result, int32& OutBestIdx);
+
+	static FORCEINLINE FSRDMatrix::EActivationFunc ToMatrixActivation(ESRActivationFunc InActivation)
+	{
+		return static_cast<FSRDMatrix::EActivationFunc>(InActivation);
+	}
+
+	static FORCEINLINE float Activate(float Z, ESRActivationFunc InActivation)
+	{
+		switch (InActivation)
+		{
+		case ESRActivationFunc::ReLU:
+			return FMath::Max<float>(Z, 0.001f * Z);
+		case ESRActivationFunc::TanH:
+			//same expression as FSRDMatrix::TanHFunc so both paths round identically.
+			return 2.0f * (1.0f / (1.0f + FMath::Exp(-(2.0f * Z)))) - 1.0f;
+		default:
+			return 1.0f / (1.0f + FMath::Exp(-Z));
+		}
+	}
+
+	/*
+	* Error multiplied by derivative of the activation, evaluated in the same order as GetLayerGradient.
+	*/
+	static FORCEINLINE float GetNodeGradient(float Error, float Y, ESRActivationFunc InActivation)
+	{
+		switch (InActivation)
+		{
+		case ESRActivationFunc::ReLU:
+			return Error * (Y > 0.0f ? 1.0f : 0.001f);
+		case ESRActivationFunc::TanH:
+			return Error * (1.0f - Y * Y);
+		default:
+			return (Error * Y) * (1.0f - Y);
+		}
+	}
+
+private:
+	void TrainHierarchical(const TArray<float>& InputList, const TArray<float>& OutputList);
+
+	/*
+	* Error multiplied by derivative of the layer's activation (Y is already activated output of the layer).
+	*/
+	static FSRDMatrix GetLayerGradient(FSRDMatrix& Errors, FSRDMatrix& Y, ESRActivationFunc InActivation);
 
 
 };
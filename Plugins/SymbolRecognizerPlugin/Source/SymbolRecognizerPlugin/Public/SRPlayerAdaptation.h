@@ -0,0 +1,110 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#pragma once
+#include "SRNeuralNetwork.h"
+#include "GameFramework/SaveGame.h"
+#include "SRPlayerAdaptation.generated.h"
+
+/*
+ * Difference between player's output layer and the one shipped in profile.
+ */
+USTRUCT(NotBlueprintable)
+struct SYMBOLRECOGNIZERPLUGIN_API FSROutputLayerDelta
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	uint32 HiddenNodes = 0;
+	UPROPERTY()
+	uint32 OutputNodes = 0;
+	/*
+	* Checksum of the base network output layer, delta is dropped when profile was retrained.
+	*/
+	UPROPERTY()
+	uint32 BaseChecksum = 0;
+	//OutputNodes x HiddenNodes, row major like who.
+	UPROPERTY()
+	TArray<float> Delta;
+	UPROPERTY()
+	int32 ConfirmedSamples = 0;
+};
+
+/*
+ * Per-player deltas of every profile, saved in its own slot so shared USymbolRecognizerData stays untouched.
+ */
+UCLASS()
+class SYMBOLRECOGNIZERPLUGIN_API USRPlayerAdaptationSave : public USaveGame
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY()
+	TMap<FString, FSROutputLayerDelta> Profiles;
+};
+
+/*
+ * Fine-tunes only the output layer (who) on symbols confirmed by the player.
+ * Hidden layer of every confirmed drawing is computed once and kept in a small ring buffer,
+ * training steps are replayed from it in slices that fit into the given time budget.
+ * Only the output layer is copied, the hidden layer is read from the base network.
+ */
+class SYMBOLRECOGNIZERPLUGIN_API FSRPlayerAdaptation
+{
+public:
+	static const int32 BufferSize = 32;
+	//training steps scheduled per confirmed sample (replayed round robin over the whole buffer).
+	static const int32 StepsPerSample = 8;
+	//adaptation uses smaller steps than editor training, so single wrong confirmation can't break the model.
+	static constexpr float LearningRateScale = 0.25f;
+
+	/*
+	* Base network must outlive this object (or Reset must be called again when it changes).
+	* @ InSaved delta to apply, ignored when it doesn't match InBase.
+	*/
+	void Reset(const FSRNeuralNetwork* InBase, const FSROutputLayerDelta* InSaved);
+	/*
+	* Two-level output layers are not supported.
+	*/
+	bool IsActive() const;
+	FORCEINLINE const FSRNeuralNetwork& GetBaseNetwork() const { return *Base; }
+	FORCEINLINE const FSRDMatrix& GetOutputLayer() const { return AdaptedWho; }
+	/*
+	* Same as FSRNeuralNetwork::Query of the base network with adapted output layer.
+	*/
+	FSRDMatrix Query(const TArray<float>& InInput, const TBitArray<>* AllowedOutputs = nullptr) const;
+	FORCEINLINE bool HasPendingSteps() const { return PendingSteps > 0; }
+	FORCEINLINE bool HasChanges() const { return bHasChanges; }
+
+	/*
+	* @ InInput data in network's input encoding.
+	*/
+	void AddConfirmedSample(const TArray<float>& InInput, int32 InSymbolId);
+	/*
+	* Runs training steps until InBudgetSeconds elapses (at least one step when there is work).
+	* @ return steps done.
+	*/
+	int32 Tick(double InBudgetSeconds);
+
+	void GetDelta(FSROutputLayerDelta& OutDelta) const;
+	static uint32 GetWeightsChecksum(const FSRNeuralNetwork& InNetwork);
+
+private:
+	struct FSample
+	{
+		TArray<float, TInlineAllocator<128>> HiddenOutputs;
+		int32 SymbolId;
+	};
+
+	const FSRNeuralNetwork* Base = nullptr;
+	FSRDMatrix AdaptedWho;
+	FSRDMatrix BaseWho;
+	uint32 BaseChecksum = 0;
+	TArray<FSample> Samples;
+	int32 NextWriteIdx = 0;
+	int32 NextReplayIdx = 0;
+	int32 PendingSteps = 0;
+	int32 ConfirmedSamples = 0;
+	bool bHasChanges = false;
+
+	void Step(const FSample& InSample);
+};
@@ -0,0 +1,83 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#pragma once
+#include "SRRecognizerBackend.h"
+#include "SRPointCloudRecognizer.generated.h"
+
+/*
+ * Strokes of one saved image, flattened so they can be stored in SRData.
+ */
+USTRUCT(NotBlueprintable)
+struct SYMBOLRECOGNIZERPLUGIN_API FSRStrokeSample
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 SymbolId = 0;
+	UPROPERTY()
+	int32 ImageId = 0;
+	UPROPERTY()
+	TArray<FVector2D> Points;
+	//index of the first point of every stroke.
+	UPROPERTY()
+	TArray<int32> LineStarts;
+	/*
+	* Sample was rebuilt from image pixels (image saved before strokes were recorded).
+	*/
+	UPROPERTY()
+	bool bFromPixels = false;
+
+	FSRStrokeSample() {}
+	FSRStrokeSample(int32 InSymbolId, int32 InImageId, const TArray<FSRDrawLine>& InLines);
+
+	/*
+	* Builds a single 'stroke' from pixels brighter than InThreshold (data as returned by GetDataFromTexture).
+	*/
+	static FSRStrokeSample FromPixels(int32 InSymbolId, int32 InImageId, const TArray<float>& InImageData, float InThreshold = 0.5f);
+
+	void ToDrawLines(TArray<FSRDrawLine>& OutLines) const;
+};
+
+/*
+ * Training-free recognizer in the style of $P/$Q gestures recognizers.
+ * Every saved sample becomes a template: strokes are resampled to a fixed count of points,
+ * scaled to a unit box and moved to the centroid (optionally rotated), then matched as unordered point clouds.
+ */
+class SYMBOLRECOGNIZERPLUGIN_API FSRPointCloudRecognizer : public ISRRecognizerBackend
+{
+public:
+	static const int32 NumPoints = 32;
+
+	/*
+	* @ InSymbolsAmount samples of symbols out of range are skipped, 0 means symbols count is taken from samples.
+	*/
+	void SetTemplates(const TArray<FSRStrokeSample>& InSamples, int32 InSymbolsAmount, bool bInRotationInvariant);
+	void Reset();
+
+	virtual bool IsReady() const override;
+	virtual FSRDMatrix Recognize(const FSRRecognizerInput& Input) const override;
+	virtual const TCHAR* GetBackendName() const override { return TEXT("PointCloud"); }
+
+	/*
+	* @ OutBestSymbol symbol of the closest template (-1 when there are no templates).
+	* @ return matching distance to that template (average distance of matched points).
+	*/
+	float Classify(const TArray<FSRDrawLine>& InLines, int32& OutBestSymbol) const;
+
+	FORCEINLINE int32 GetTemplatesCount() const { return Templates.Num(); }
+
+private:
+	struct FCloudTemplate
+	{
+		int32 SymbolId;
+		TArray<FVector2D> Points;
+	};
+
+	TArray<FCloudTemplate> Templates;
+	int32 SymbolsAmount = 0;
+	bool bRotationInvariant = false;
+
+	bool Normalize(const TArray<FSRDrawLine>& InLines, bool bInCloud, TArray<FVector2D>& OutPoints) const;
+	static float GreedyCloudMatch(const TArray<FVector2D>& InPoints, const TArray<FVector2D>& InTemplate, float InMinSoFar);
+	static float CloudDistance(const TArray<FVector2D>& InPoints, const TArray<FVector2D>& InTemplate, int32 InStart, float InMinSoFar);
+};
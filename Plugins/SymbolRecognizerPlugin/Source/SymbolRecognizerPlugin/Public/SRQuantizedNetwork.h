@@ -0,0 +1,81 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#pragma once
+#include "SRNeuralNetwork.h"
+#include "SRQuantizedNetwork.generated.h"
+
+/*
+ * Int8 copy of FSRNeuralNetwork used for runtime recognition.
+ * Weights are stored with one scale per row, activations use a single scale per layer
+ * calibrated from the profile's training images.
+ */
+USTRUCT()
+struct SYMBOLRECOGNIZERPLUGIN_API FSRQuantizedNetwork
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		uint32 InputNodes = 0;
+	UPROPERTY()
+		uint32 HiddenNodes = 0;
+	UPROPERTY()
+		uint32 OutputNodes = 0;
+	//rows are padded with zeros to a multiple of 32 so kernels never need a tail loop.
+	UPROPERTY()
+		uint32 InputStride = 0;
+	UPROPERTY()
+		uint32 HiddenStride = 0;
+	UPROPERTY()
+		TArray<int8> wih;
+	UPROPERTY()
+		TArray<int8> who;
+	UPROPERTY()
+		TArray<float> wihScales;
+	UPROPERTY()
+		TArray<float> whoScales;
+	UPROPERTY()
+		ESRActivationFunc HiddenActivation = ESRActivationFunc::Sigmoid;
+	UPROPERTY()
+		ESRActivationFunc OutputActivation = ESRActivationFunc::Sigmoid;
+	UPROPERTY()
+		float InputScale = 1.0f;
+	UPROPERTY()
+		float HiddenScale = 1.0f;
+	/*
+	* Ratio of calibration images for which int8 and float networks picked the same symbol.
+	*/
+	UPROPERTY()
+		float AgreementRate = 0.0f;
+	UPROPERTY()
+		bool bIsValid = false;
+
+	FSRQuantizedNetwork() {};
+
+	/*
+	* @ InNetwork trained float network to convert.
+	* @ CalibrationInputs images used to find activations range (usually all profile's training images).
+	* @ return true when network got quantized.
+	*/
+	bool Build(const FSRNeuralNetwork& InNetwork, const TArray<TArray<float>>& CalibrationInputs);
+	float MeasureAgreement(const FSRNeuralNetwork& InNetwork, const TArray<TArray<float>>& Inputs) const;
+
+	/*
+	* @ AllowedOutputs only these output rows are evaluated (nullptr allows all), other rows are 0.
+	*/
+	FSRDMatrix Query(const TArray<float>& InputList, const TBitArray<>* AllowedOutputs = nullptr) const;
+	void Query(const TArray<float>& InputList, TArray<float>& OutResult, const TBitArray<>* AllowedOutputs = nullptr) const;
+
+	FORCEINLINE bool IsCompatibleWith(const FSRNeuralNetwork& InNetwork) const
+	{
+		return bIsValid && !InNetwork.IsHierarchical() && InputNodes == InNetwork.InputNodes && HiddenNodes == InNetwork.HiddenNodes && OutputNodes == InNetwork.OutputNodes
+			&& HiddenActivation == InNetwork.HiddenActivation && OutputActivation == InNetwork.OutputActivation;
+	}
+
+	static const TCHAR* GetKernelName();
+	static int32 DotProduct(const int8* A, const int8* B, uint32 Count);
+
+private:
+	static uint32 GetPaddedStride(uint32 InCount);
+	static void QuantizeRow(const TArray<float>& InRow, uint32 InStride, TArray<int8>& OutData, float& OutScale);
+	static int8 QuantizeValue(float InValue, float InInvScale);
+};
@@ -0,0 +1,106 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#pragma once
+#include "SRMatrix.h"
+#include "SRCanvasHandler.h"
+#include "SRRecognizerBackend.generated.h"
+
+/*
+ * Method used by USymbolRecognizer to tell drawn symbols apart.
+ */
+UENUM(BlueprintType)
+enum class ESRRecognizerBackend : uint8
+{
+	//Multilayer perceptron trained on profile's images (default).
+	NeuralNetwork = 0,
+	//Point cloud matching against saved strokes. Needs no training.
+	PointCloud
+};
+
+/*
+ * Drawing data passed to a backend. Texture data is read only when a backend asks for it.
+ */
+struct SYMBOLRECOGNIZERPLUGIN_API FSRRecognizerInput
+{
+	FSRRecognizerInput(const USRCanvasHandler* InCanvas) :
+		Canvas(InCanvas)
+	{}
+
+	FSRRecognizerInput(const TArray<float>& InImageData, const TArray<FSRDrawLine>& InStrokes) :
+		ImageData(InImageData),
+		Strokes(InStrokes),
+		bHasImageData(true),
+		bHasStrokes(true)
+	{}
+
+	const TArray<float>& GetImageData() const
+	{
+		if (!bHasImageData && Canvas)
+		{
+			Canvas->GetDataFromTexture(ImageData);
+			bHasImageData = true;
+		}
+
+		return ImageData;
+	}
+
+	const TArray<FSRDrawLine>& GetStrokes() const
+	{
+		return (!bHasStrokes && Canvas) ? Canvas->GetDrawLinesRef() : Strokes;
+	}
+
+	/*
+	* Backends may skip symbols that are not allowed (their accuracy is 0).
+	*/
+	FORCEINLINE void SetAllowedSymbols(const TBitArray<>* InAllowedSymbols) { AllowedSymbols = InAllowedSymbols; }
+	FORCEINLINE const TBitArray<>* GetAllowedSymbols() const { return AllowedSymbols; }
+	FORCEINLINE bool IsSymbolAllowed(int32 InSymbolId) const
+	{
+		return AllowedSymbols == nullptr || (InSymbolId < AllowedSymbols->Num() && (*AllowedSymbols)[InSymbolId]);
+	}
+
+private:
+	const USRCanvasHandler* Canvas = nullptr;
+	const TBitArray<>* AllowedSymbols = nullptr;
+	mutable TArray<float> ImageData;
+	TArray<FSRDrawLine> Strokes;
+	mutable bool bHasImageData = false;
+	bool bHasStrokes = false;
+};
+
+/*
+ * Common interface of USymbolRecognizer backends.
+ */
+class SYMBOLRECOGNIZERPLUGIN_API ISRRecognizerBackend
+{
+public:
+	virtual ~ISRRecognizerBackend() {}
+
+	/*
+	* @ return false when backend has no data for current profile (e.g. network not trained).
+	*/
+	virtual bool IsReady() const = 0;
+	/*
+	* @ return column matrix with accuracy (0-1) of every symbol.
+	*/
+	virtual FSRDMatrix Recognize(const FSRRecognizerInput& Input) const = 0;
+	virtual const TCHAR* GetBackendName() const = 0;
+};
+
+/*
+ * Forwards recognition to USymbolRecognizer's networks (cascade, int8 or float).
+ */
+class SYMBOLRECOGNIZERPLUGIN_API FSRNetworkBackend : public ISRRecognizerBackend
+{
+public:
+	FSRNetworkBackend(const class USymbolRecognizer* InOwner) :
+		Owner(InOwner)
+	{}
+
+	virtual bool IsReady() const override;
+	virtual FSRDMatrix Recognize(const FSRRecognizerInput& Input) const override;
+	virtual const TCHAR* GetBackendName() const override { return TEXT("NeuralNetwork"); }
+
+private:
+	const class USymbolRecognizer* Owner;
+};
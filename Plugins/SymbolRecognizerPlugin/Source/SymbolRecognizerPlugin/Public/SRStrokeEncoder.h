@@ -0,0 +1,24 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+
+#pragma once
+#include "SRCanvasHandler.h"
+
+/*
+ * Compact network input computed straight from FSRDrawLine points (no render target needed).
+ * Drawing is fitted into a square split into GridSize x GridSize cells and every cell holds
+ * a histogram of strokes orientations weighted by strokes length.
+ */
+struct SYMBOLRECOGNIZERPLUGIN_API FSRStrokeEncoder
+{
+	static const int32 GridSize = 4;
+	//orientations are undirected (0-180 deg) so drawing direction of a stroke doesn't matter.
+	static const int32 Orientations = 8;
+
+	static FORCEINLINE int32 GetDescriptorSize() { return GridSize * GridSize * Orientations; }
+
+	/*
+	* @ OutDescriptor values are in the same range as pixels data (0.01-0.99).
+	* @ return false when there is nothing drawn.
+	*/
+	static bool Encode(const TArray<FSRDrawLine>& InLines, TArray<float>& OutDescriptor);
+};
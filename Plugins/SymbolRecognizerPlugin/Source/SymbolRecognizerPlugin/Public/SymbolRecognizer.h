@@ -3,6 +3,11 @@
 #pragma once
 
 #include "SRNeuralNetwork.h"
+#include "SRQuantizedNetwork.h"
+#include "SRPointCloudRecognizer.h"
+#include "SRIncrementalQuery.h"
+#include "SRNetworkMailbox.h"
+#include "SRPlayerAdaptation.h"
 #include "SRCanvasHandler.h"
 #include "SymbolRecognizer.generated.h"
 
@@ -17,6 +22,95 @@ struct FSRDrawLayerWrapper
 	FSRDrawLayerWrapper() {}
 	FSRDrawLayerWrapper(const TArray<FSRDrawingLayer>& InDrawLayers) : DrawLayers(InDrawLayers){}
 };
+
+/*
+ * Models of one profile that can answer recognition queries, from the most to the least accurate.
+ */
+UENUM(BlueprintType)
+enum class ESRModelVariant : uint8
+{
+	Full = 0,
+	//network with the least important hidden nodes removed.
+	Pruned,
+	//int8 network.
+	Quantized
+};
+
+/*
+ * Additional models generated for a profile next to its main FSRNeuralNetwork.
+ */
+USTRUCT(NotBlueprintable)
+struct SYMBOLRECOGNIZERPLUGIN_API FSRProfileModels
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FSRQuantizedNetwork QuantizedNetwork;
+	/*
+	* Smaller copy of the main network used on slow devices (see USymbolRecognizer::bSelectModelByLatency).
+	*/
+	UPROPERTY()
+	FSRNeuralNetwork PrunedNetwork;
+	UPROPERTY()
+	float PrunedAgreementRate = 0.0f;
+	/*
+	* Small first-stage network of the confidence cascade. Not used when not trained.
+	*/
+	UPROPERTY()
+	FSRNeuralNetwork CascadeNetwork;
+	UPROPERTY()
+	float CascadeExitMargin = 0.5f;
+	UPROPERTY()
+	ESRRecognizerBackend Backend = ESRRecognizerBackend::NeuralNetwork;
+	/*
+	* Strokes of saved images, used as templates by the point cloud backend.
+	*/
+	UPROPERTY()
+	TArray<FSRStrokeSample> StrokeSamples;
+	UPROPERTY()
+	bool bPointCloudRotationInvariant = false;
+	/*
+	* Hash of images and params the saved network was trained with, 0 when unknown.
+	* Editor skips training of the profile while its hash doesn't change.
+	*/
+	UPROPERTY()
+	uint32 TrainingHash = 0;
+
+	FSRStrokeSample* FindStrokeSample(int32 InSymbolId, int32 InImageId)
+	{
+		return StrokeSamples.FindByPredicate([&](const FSRStrokeSample& Sample) { return Sample.SymbolId == InSymbolId && Sample.ImageId == InImageId; });
+	}
+};
+
+/*
+ * Hidden layer used by many profiles, each of them stores only its output layer.
+ */
+USTRUCT(NotBlueprintable)
+struct SYMBOLRECOGNIZERPLUGIN_API FSRSharedTrunk
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FSRDMatrix wih = FSRDMatrix(0, 0, 0);
+	UPROPERTY()
+	uint32 InputNodes = 0;
+	UPROPERTY()
+	uint32 HiddenNodes = 0;
+	UPROPERTY()
+	ESRActivationFunc HiddenActivation = ESRActivationFunc::Sigmoid;
+	UPROPERTY()
+	ESRInputEncoding InputEncoding = ESRInputEncoding::Pixels;
+	//increased every time trunk is trained again, heads trained on older revision are not valid anymore.
+	UPROPERTY()
+	uint32 Revision = 0;
+
+	bool IsCompatibleWith(const FSRNeuralNetwork& InNetwork) const
+	{
+		return InputNodes == InNetwork.InputNodes && HiddenNodes == InNetwork.HiddenNodes
+			&& HiddenActivation == InNetwork.HiddenActivation && InputEncoding == InNetwork.InputEncoding;
+	}
+};
+
 UCLASS()
 class SYMBOLRECOGNIZERPLUGIN_API USymbolRecognizerData : public UObject
 {
@@ -30,6 +124,10 @@ class SYMBOLRECOGNIZERPLUGIN_API USymbolRecognizerData : public UObject
 	TMap<FString, FSRNeuralNetwork> NeuralProfiles;
 	UPROPERTY()
 	TMap<FString, FSRDrawLayerWrapper> DrawLayers;
+	UPROPERTY()
+	TMap<FString, FSRProfileModels> ProfileModels;
+	UPROPERTY()
+	TMap<FName, FSRSharedTrunk> SharedTrunks;
 
 	bool ReadDrawLayers(const FString InProfile, TArray<FSRDrawingLayer>& OutDrawLayers)
 	{
@@ -60,6 +158,7 @@ class SYMBOLRECOGNIZERPLUGIN_API USymbolRecognizer : public UObject
 	GENERATED_BODY()
 
 	friend class USRCanvasHandler;
+	friend class FSRNetworkBackend;
 	
 public:
 	static const FString SymbolRecognizerMountPoint;
@@ -98,6 +197,58 @@ public:
 	int32 GetMostAccurateSymbol(float AccuracyTreshold = 0.3f) const;
 	TArray<float> GetAccuracyList() const;
 
+	/*
+	* Test current drawing only against given symbols (e.g. spells player can cast now), other outputs are not evaluated.
+	* @param AllowedSymbols			ids of symbols to test.
+	* @param AccuracyTreshold		(0-1) drawing accuracy must be bigger to pass.
+	* @return SymbolId if found, otherwise -1.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "SymbolRecognizerPlugin")
+	int32 GetMostAccurateSymbolFromSet(const TArray<int32>& AllowedSymbols, float AccuracyTreshold = 0.3f) const;
+	int32 GetMostAccurateAllowedSymbol(const TBitArray<>& AllowedSymbols, float AccuracyTreshold = 0.3f) const;
+	/*
+	* Accuracy of allowed symbols normalized so they sum up to 1 (not allowed symbols are 0).
+	*/
+	TArray<float> GetAllowedAccuracyList(const TBitArray<>& AllowedSymbols) const;
+	static TBitArray<> MakeSymbolsMask(const TArray<int32>& InSymbols);
+
+	/*
+	* Cheap recognition meant to be called every frame while drawing (e.g. to preview the symbol being drawn).
+	* Result is recomputed only when the drawing changed, the network updates only hidden sums of changed inputs.
+	* Cascade and int8 networks are not used here.
+	* @param OutAccuracy			(0-1) accuracy of returned symbol.
+	* @return SymbolId of the best guess, -1 when nothing is drawn or network isn't trained.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "SymbolRecognizerPlugin")
+	int32 GetLiveBestGuess(float& OutAccuracy);
+
+	/*
+	* Tell the recognizer which symbol current drawing really was (e.g. after successful cast).
+	* Must be called before ClearCanvas. Does nothing when player adaptation is disabled.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "SymbolRecognizerPlugin|Adaptation")
+	void ConfirmSymbol(int32 SymbolId);
+	/*
+	* Runs pending adaptation training for at most BudgetMicroseconds. Should be called in Tick.
+	* @return true when there is still work left.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "SymbolRecognizerPlugin|Adaptation")
+	bool UpdatePlayerAdaptation(float BudgetMicroseconds = 200.0f);
+	/*
+	* Writes player's output layer deltas to AdaptationSaveSlot.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "SymbolRecognizerPlugin|Adaptation")
+	bool SavePlayerAdaptation();
+	/*
+	* Drops what was learned for current profile (call SavePlayerAdaptation to persist it).
+	*/
+	UFUNCTION(BlueprintCallable, Category = "SymbolRecognizerPlugin|Adaptation")
+	void ResetPlayerAdaptation();
+	UFUNCTION(BlueprintCallable, Category = "SymbolRecognizerPlugin|Adaptation")
+	void SetPlayerAdaptationEnabled(bool bInEnabled);
+	UFUNCTION(BlueprintPure, Category = "SymbolRecognizerPlugin|Adaptation")
+	bool IsUsingPlayerAdaptation() const;
+
 	UFUNCTION(BlueprintCallable, Category = "SymbolRecognizerPlugin")
 	class USRCanvasHandler* GetCanvasHandler() const;
 	FORCEINLINE int32 GetSymbolTextureSize() const { return NeuralTextureSize; };
@@ -127,10 +278,117 @@ public:
 
 	FSRNeuralNetwork& GetNeuralNetworkRef(bool bTryLoad = true);
 
+	/*
+	* Converts current profile's network to int8 and stores it next to the float one.
+	* @param CalibrationInputs		training images used to calibrate activations scales.
+	* @return agreement rate (0-1) between int8 and float models, negative when conversion failed.
+	*/
+	float BuildQuantizedNetwork(const TArray<TArray<float>>& CalibrationInputs);
+	/*
+	* Use int8 network (if it was built for current profile) instead of float one.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "SymbolRecognizerPlugin")
+	void SetUseQuantizedNetwork(bool bInUseQuantizedNetwork);
+	UFUNCTION(BlueprintPure, Category = "SymbolRecognizerPlugin")
+	bool IsUsingQuantizedNetwork() const;
+
+	/*
+	* Builds pruned variant of current profile's network.
+	* @param CalibrationInputs		training images, the pruned network output layer is fine-tuned to match the full network on them.
+	* @param InRemovedRatio			(0-1) fraction of hidden nodes to remove.
+	* @return agreement rate (0-1) with the full network, negative when pruning failed.
+	*/
+	float BuildPrunedNetwork(const TArray<TArray<float>>& CalibrationInputs, float InRemovedRatio);
+	/*
+	* Pruning step of BuildPrunedNetwork, uses only given networks so it can run on any thread.
+	* @return agreement rate (0-1) of OutPruned with InNetwork, negative when pruning failed.
+	*/
+	static float MakePrunedNetwork(const FSRNeuralNetwork& InNetwork, const TArray<TArray<float>>& CalibrationInputs, float InRemovedRatio, FSRNeuralNetwork& OutPruned);
+	/*
+	* Stores network built by MakePrunedNetwork in current profile.
+	*/
+	void SavePrunedNetwork(const FSRNeuralNetwork& InPruned, float InAgreementRate);
+	bool IsModelVariantAvailable(ESRModelVariant InVariant) const;
+	/*
+	* Model answering queries: sr.ModelVariant console variable, then latency based selection (when enabled), then bUseQuantizedNetwork.
+	*/
+	UFUNCTION(BlueprintPure, Category = "SymbolRecognizerPlugin")
+	ESRModelVariant GetActiveModelVariant() const;
+	/*
+	* Measures recognition time of every available variant and picks the most accurate one within RecognitionBudgetMicroseconds
+	* (or the fastest when none fits). Done automatically when profile is loaded and bSelectModelByLatency is set.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "SymbolRecognizerPlugin")
+	ESRModelVariant SelectModelVariantByLatency();
+
+	/*
+	* First-stage network of the cascade, trained alongside the main one.
+	*/
+	FSRNeuralNetwork& GetCascadeNetworkRef();
+	/*
+	* Stores cascade network in current profile (or removes it when bInEnabled is false).
+	*/
+	void SaveCascadeNetwork(bool bInEnabled, float InExitMargin);
+	/*
+	* Ratio of queries answered by the cascade first stage without running the full network.
+	*/
+	UFUNCTION(BlueprintPure, Category = "SymbolRecognizerPlugin")
+	float GetCascadeEarlyExitRate() const;
+
+	/*
+	* Select the method used to recognize symbols (stays until profile changes).
+	* Falls back to the neural network when selected backend has no data for current profile.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "SymbolRecognizerPlugin")
+	void SetRecognizerBackend(ESRRecognizerBackend InBackend);
+	UFUNCTION(BlueprintPure, Category = "SymbolRecognizerPlugin")
+	ESRRecognizerBackend GetRecognizerBackend() const;
+	const ISRRecognizerBackend& GetActiveBackend() const;
+	UFUNCTION(BlueprintPure, Category = "SymbolRecognizerPlugin")
+	bool IsBackendReady(ESRRecognizerBackend InBackend) const;
+
+	/*
+	* Stores default backend of current profile and rebuilds point cloud templates.
+	*/
+	void SaveProfileBackend(ESRRecognizerBackend InBackend, bool bInRotationInvariant);
+	/*
+	* Hash of images and params the network of current profile was trained with (see FSRProfileModels::TrainingHash).
+	*/
+	void SaveTrainingHash(uint32 InHash);
+	uint32 GetTrainingHash() const;
+	/*
+	* Adds or replaces strokes saved for given symbol's image in current profile.
+	*/
+	void SaveStrokeSample(const FSRStrokeSample& InSample);
+	void RemoveStrokeSample(int32 InSymbolId, int32 InImageId);
+	bool HasStrokeSample(int32 InSymbolId, int32 InImageId) const;
+	bool GetStrokeSample(int32 InSymbolId, int32 InImageId, FSRStrokeSample& OutSample) const;
+	/*
+	* Removes samples of symbols and images that are no longer part of current profile.
+	*/
+	void RemoveStrokeSamplesOutOfRange(int32 InSymbolsAmount, int32 InImagesPerSymbol);
+	void RefreshPointCloudTemplates();
+
+	/*
+	* Stores hidden layer of InNetwork as shared trunk InName (next revision) and links InNetwork to it.
+	* Profiles trained on the previous revision must be trained again.
+	*/
+	void SaveSharedTrunk(FName InName, FSRNeuralNetwork& InNetwork);
+	const FSRSharedTrunk* FindSharedTrunk(FName InName) const;
+	void ClearQuantizedNetwork();
+	void ClearPrunedNetwork();
+
 	void SaveNeuralProfile(const FString InProfile, FSRNeuralNetwork& InNeuralNetwork);
 	void SaveNeuralProfile(const FString InProfile);
 	bool LoadNeuralNetworkFromSRData(FSRNeuralNetwork& NeuralData);
 	bool SelectProfile(const FString InProfile, bool bAddEmptyIfNotFound = false, bool bShouldSave = true);
+	/*
+	* Networks published to the mailbox of current profile replace the saved network in queries (no cascade, model variants or adaptation)
+	* until the profile is selected or saved again, so recognition can be tested while training goes on.
+	* @ InMailbox nullptr removes the mailbox of InProfile and its preview.
+	*/
+	void SetNetworkMailbox(const FString& InProfile, const TSharedPtr<FSRNetworkMailbox, ESPMode::ThreadSafe>& InMailbox);
+	FORCEINLINE bool IsPreviewingNetwork() const { return PreviewNetwork.IsValid(); }
 
 	void SaveSRData();
 	void LoadSRData();
@@ -162,14 +420,76 @@ private:
 
 	UPROPERTY(Transient)
 	FSRNeuralNetwork NeuralNetwork;
+	UPROPERTY(Transient)
+	FSRQuantizedNetwork QuantizedNetwork;
+	UPROPERTY(Transient)
+	FSRNeuralNetwork CascadeNetwork;
+	float CascadeExitMargin = 0.5f;
+	mutable int32 CascadeQueries = 0;
+	mutable int32 CascadeEarlyExits = 0;
+	//early exit rate is logged every N cascade queries.
+	static constexpr int32 CascadeLogInterval = 1000;
+	ESRRecognizerBackend RecognizerBackend = ESRRecognizerBackend::NeuralNetwork;
+	FSRNetworkBackend NetworkBackend = FSRNetworkBackend(this);
+	FSRPointCloudRecognizer PointCloudRecognizer;
+	FSRIncrementalQuery LiveQuery;
+	//canvas revision of the last live guess, LiveQuery needs Reset when network changed.
+	uint32 LiveQueryRevision = 0;
+	int32 LiveBestGuess = -1;
+	float LiveBestAccuracy = 0.0f;
+	mutable bool bLiveQueryDirty = true;
+	//training mailboxes by profile name, game thread only.
+	TMap<FString, TSharedPtr<FSRNetworkMailbox, ESPMode::ThreadSafe>> NetworkMailboxes;
+	//latest network taken from the mailbox of current profile.
+	mutable TUniquePtr<FSRNeuralNetwork> PreviewNetwork;
 	bool bIsLoaded = false;
 	UPROPERTY(EditAnywhere, Category = "Training")
 	int32 NeuralTextureSize = 28;
+	/*
+	* Run recognition on int8 network when available. Cuts weights memory 4x and speeds up queries on low-end CPUs.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Training")
+	bool bUseQuantizedNetwork = false;
+	/*
+	* Benchmark model variants of the profile on load and use the most accurate one that fits RecognitionBudgetMicroseconds.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Quality")
+	bool bSelectModelByLatency = false;
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "1", UIMin = "1", EditCondition = "bSelectModelByLatency"), Category = "Quality")
+	float RecognitionBudgetMicroseconds = 500.0f;
+	UPROPERTY(Transient)
+	FSRNeuralNetwork PrunedNetwork;
+	float PrunedAgreementRate = 0.0f;
+	ESRModelVariant BenchmarkedVariant = ESRModelVariant::Full;
+	/*
+	* Fine-tune output layer on symbols confirmed by player (see ConfirmSymbol).
+	* Cascade and int8 networks are skipped while adapted network is used.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Adaptation")
+	bool bEnablePlayerAdaptation = false;
+	UPROPERTY(EditAnywhere, Category = "Adaptation")
+	FString AdaptationSaveSlot = "SRPlayerAdaptation";
+	UPROPERTY(EditAnywhere, Category = "Adaptation")
+	int32 AdaptationUserIndex = 0;
+	UPROPERTY(Transient)
+	USRPlayerAdaptationSave* PlayerAdaptationSave = nullptr;
+	FSRPlayerAdaptation PlayerAdaptation;
 	bool bIsDrawing = false;
 	bool bAddNewDrawSpot = false;
 
 	
 
 	FORCEINLINE FString GetSRDataPackageName() const;
+	FSRDMatrix QueryNetwork(const TArray<float>& QueryData, const TBitArray<>* AllowedSymbols = nullptr) const;
+	FSRDMatrix QueryModelVariant(ESRModelVariant InVariant, const TArray<float>& QueryData, const TBitArray<>* AllowedSymbols) const;
+	FSRDMatrix Recognize(const TBitArray<>* AllowedSymbols) const;
+	int32 PickMostAccurateSymbol(const FSRDMatrix& Result, const TBitArray<>* AllowedSymbols, float AccuracyThreshold) const;
+	void LoadProfileModels();
+	void LoadPlayerAdaptation();
+	void LogCascadeEarlyExitRate() const;
+	//OutOutputLayer replaces who of the returned network when set (player adaptation).
+	const FSRNeuralNetwork& GetRecognitionNetwork(const FSRDMatrix*& OutOutputLayer) const;
+	//takes the latest network published for current profile.
+	void ConsumePublishedNetwork() const;
 
 };
@@ -0,0 +1,144 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#include "SREpochSampler.h"
+#include "SRNeuralNetwork.h"
+
+template<typename T>
+void FSREpochSampler::Shuffle(TArray<T>& InOutArray)
+{
+	for (int32 I = InOutArray.Num() - 1; I > 0; --I)
+	{
+		InOutArray.Swap(I, Random.RandRange(0, I));
+	}
+}
+
+void FSREpochSampler::Init(const TArray<int32>& InSamplesPerSet, ESRSamplingMode InMode, bool bInInterleaveSequential, int32 InSeed)
+{
+	Mode = InMode;
+	bInterleaveSequential = bInInterleaveSequential;
+	Random.Initialize(InSeed);
+	SamplesPerSet = InSamplesPerSet;
+
+	SetOffsets.SetNumUninitialized(SamplesPerSet.Num());
+	int32 SamplesCount = 0;
+	for (int32 SetIdx = 0; SetIdx < SamplesPerSet.Num(); ++SetIdx)
+	{
+		SetOffsets[SetIdx] = SamplesCount;
+		SamplesCount += SamplesPerSet[SetIdx];
+	}
+	Hardness.Init(ESRSampleHardness::Unknown, SamplesCount);
+}
+
+void FSREpochSampler::BuildEpoch(TArray<TPair<int32, int32>>& OutOrder)
+{
+	OutOrder.Reset();
+
+	const bool bAllSolved = Mode == ESRSamplingMode::HardExamples && Hardness.Num() > 0 && !Hardness.ContainsByPredicate([](ESRSampleHardness Value) { return Value != ESRSampleHardness::Solved; });
+	if (Mode == ESRSamplingMode::Shuffle || (Mode == ESRSamplingMode::Sequential && !bInterleaveSequential) || bAllSolved)
+	{
+		for (int32 SetIdx = 0; SetIdx < SamplesPerSet.Num(); ++SetIdx)
+		{
+			for (int32 InputIdx = 0; InputIdx < SamplesPerSet[SetIdx]; ++InputIdx)
+				OutOrder.Emplace(SetIdx, InputIdx);
+		}
+
+		if (Mode != ESRSamplingMode::Sequential)
+			Shuffle(OutOrder);
+		return;
+	}
+
+	const bool bRandomize = Mode != ESRSamplingMode::Sequential;
+	TArray<TArray<int32>> InputsPerSet;
+	InputsPerSet.SetNum(SamplesPerSet.Num());
+	int32 MaxInputs = 0;
+	for (int32 SetIdx = 0; SetIdx < SamplesPerSet.Num(); ++SetIdx)
+	{
+		for (int32 InputIdx = 0; InputIdx < SamplesPerSet[SetIdx]; ++InputIdx)
+		{
+			for (int32 Repeat = GetRepeats(SetIdx, InputIdx); Repeat > 0; --Repeat)
+				InputsPerSet[SetIdx].Add(InputIdx);
+		}
+
+		if (bRandomize)
+			Shuffle(InputsPerSet[SetIdx]);
+		MaxInputs = FMath::Max(MaxInputs, InputsPerSet[SetIdx].Num());
+	}
+
+	TArray<int32> SetsOrder;
+	for (int32 SetIdx = 0; SetIdx < SamplesPerSet.Num(); ++SetIdx)
+		SetsOrder.Add(SetIdx);
+
+	for (int32 Round = 0; Round < MaxInputs; ++Round)
+	{
+		if (bRandomize)
+			Shuffle(SetsOrder);
+
+		for (int32 SetIdx : SetsOrder)
+		{
+			if (InputsPerSet[SetIdx].IsValidIndex(Round))
+				OutOrder.Emplace(SetIdx, InputsPerSet[SetIdx][Round]);
+		}
+	}
+}
+
+void FSREpochSampler::SetHardness(int32 InSetIdx, int32 InInputIdx, ESRSampleHardness InHardness)
+{
+	if (SetOffsets.IsValidIndex(InSetIdx) && InInputIdx >= 0 && InInputIdx < SamplesPerSet[InSetIdx])
+	{
+		Hardness[SetOffsets[InSetIdx] + InInputIdx] = InHardness;
+	}
+}
+
+void FSREpochSampler::GetState(int32& OutSeed, TArray<uint8>& OutHardness) const
+{
+	OutSeed = Random.GetCurrentSeed();
+	OutHardness.SetNumUninitialized(Hardness.Num());
+	for (int32 I = 0; I < Hardness.Num(); ++I)
+	{
+		OutHardness[I] = (uint8)Hardness[I];
+	}
+}
+
+void FSREpochSampler::SetState(int32 InSeed, const TArray<uint8>& InHardness)
+{
+	Random.Initialize(InSeed);
+	if (InHardness.Num() == Hardness.Num())
+	{
+		for (int32 I = 0; I < Hardness.Num(); ++I)
+		{
+			Hardness[I] = (ESRSampleHardness)FMath::Min(InHardness[I], (uint8)ESRSampleHardness::Wrong);
+		}
+	}
+}
+
+ESRSampleHardness FSREpochSampler::GetHardness(const FSRDMatrix& InResult, int32 InAnswer, float InAcceptableAccuracy, float InDeltaBestAnswers)
+{
+	if (FSRNeuralNetwork::GetQueryResult(InResult, InAnswer, InAcceptableAccuracy, InDeltaBestAnswers) == 0)
+	{
+		return ESRSampleHardness::Wrong;
+	}
+
+	//passed, but closer to the threshold than to the perfect answer.
+	int32 BestIdx;
+	const float Margin = FSRNeuralNetwork::GetTopTwoMargin(InResult, BestIdx);
+	return Margin < (InDeltaBestAnswers + 1.0f) * 0.5f ? ESRSampleHardness::BarelyRight : ESRSampleHardness::Solved;
+}
+
+int32 FSREpochSampler::GetRepeats(int32 InSetIdx, int32 InInputIdx)
+{
+	if (Mode != ESRSamplingMode::HardExamples)
+	{
+		return 1;
+	}
+
+	switch (Hardness[SetOffsets[InSetIdx] + InInputIdx])
+	{
+	case ESRSampleHardness::Wrong:
+		return WrongRepeats;
+	case ESRSampleHardness::BarelyRight:
+		return BarelyRightRepeats;
+	case ESRSampleHardness::Solved:
+		return (Random.GetFraction() < SolvedKeepRatio) ? 1 : 0;
+	default:
+		return 1;
+	}
+}
@@ -0,0 +1,118 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#include "SRHyperparameterSweep.h"
+#include "Math/RandomStream.h"
+
+FString FSRSweepCandidate::GetLabel() const
+{
+	return FString::Printf(TEXT("hidden %i, rate %.3f, cycles %i"), HiddenNodes, LearningRate, LearningCycles);
+}
+
+bool FSRHyperparameterSweep::BuildCandidates(const FSRSweepSettings& InSettings)
+{
+	Candidates.Reset();
+	if (InSettings.HiddenNodes.Num() == 0 || InSettings.LearningRates.Num() == 0 || InSettings.LearningCycles.Num() == 0)
+	{
+		return false;
+	}
+
+	if (InSettings.Mode == ESRSweepMode::Grid)
+	{
+		for (int32 HiddenNodes : InSettings.HiddenNodes)
+		{
+			for (float LearningRate : InSettings.LearningRates)
+			{
+				for (int32 LearningCycles : InSettings.LearningCycles)
+				{
+					FSRSweepCandidate& Candidate = Candidates.AddDefaulted_GetRef();
+					Candidate.HiddenNodes = FMath::Max(1, HiddenNodes);
+					Candidate.LearningRate = LearningRate;
+					Candidate.LearningCycles = FMath::Max(1, LearningCycles);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	//learning rate is picked on log scale, so small rates are tried as often as big ones.
+	const float MinRate = FMath::Max(KINDA_SMALL_NUMBER, FMath::Min(InSettings.LearningRates));
+	const float MaxRate = FMath::Max(MinRate, FMath::Max(InSettings.LearningRates));
+	FRandomStream Random(InSettings.RandomSeed);
+	for (int32 Idx = 0; Idx < InSettings.RandomConfigurations; ++Idx)
+	{
+		FSRSweepCandidate& Candidate = Candidates.AddDefaulted_GetRef();
+		Candidate.HiddenNodes = FMath::Max(1, Random.RandRange(FMath::Min(InSettings.HiddenNodes), FMath::Max(InSettings.HiddenNodes)));
+		Candidate.LearningRate = FMath::Exp(Random.FRandRange(FMath::Loge(MinRate), FMath::Loge(MaxRate)));
+		Candidate.LearningCycles = FMath::Max(1, Random.RandRange(FMath::Min(InSettings.LearningCycles), FMath::Max(InSettings.LearningCycles)));
+	}
+
+	return Candidates.Num() > 0;
+}
+
+FSRSweepCandidate* FSRHyperparameterSweep::FindCandidate(const FSRTrainingJobRef& InJob)
+{
+	return Candidates.FindByPredicate([&InJob](const FSRSweepCandidate& Candidate) { return Candidate.Job == InJob; });
+}
+
+void FSRHyperparameterSweep::OnJobFinished(const FSRTrainingJobRef& InJob)
+{
+	FSRSweepCandidate* Candidate = FindCandidate(InJob);
+	if (Candidate == nullptr)
+	{
+		return;
+	}
+
+	const FSRTrainingStats Stats = InJob->GetStats();
+	Candidate->bFinished = true;
+	Candidate->Accuracy = Stats.Accuracy;
+	Candidate->TrainSeconds = Stats.TotalSeconds;
+	Candidate->InferenceFlops = InJob->Network.GetInferenceFlops();
+	Candidate->bPassed = InJob->GetState() == ESRTrainingJobState::Completed && Stats.Accuracy >= InJob->AcceptableAccuracy;
+	GLog->Log(FString::Printf(TEXT("Sweep candidate finished: %s | accuracy: %f | %s"), *InJob->GetDisplayName(), Stats.Accuracy, Candidate->bPassed ? TEXT("passed") : TEXT("failed")));
+}
+
+bool FSRHyperparameterSweep::IsFinished() const
+{
+	for (const FSRSweepCandidate& Candidate : Candidates)
+	{
+		if (!Candidate.bFinished)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+const FSRSweepCandidate* FSRHyperparameterSweep::GetBestCandidate() const
+{
+	const FSRSweepCandidate* Best = nullptr;
+	for (const FSRSweepCandidate& Candidate : Candidates)
+	{
+		if (!Candidate.bPassed)
+		{
+			continue;
+		}
+
+		if (Best == nullptr || Candidate.InferenceFlops < Best->InferenceFlops
+			|| (Candidate.InferenceFlops == Best->InferenceFlops && Candidate.Accuracy > Best->Accuracy))
+		{
+			Best = &Candidate;
+		}
+	}
+
+	return Best;
+}
+
+void FSRHyperparameterSweep::LogResults() const
+{
+	const FSRSweepCandidate* Best = GetBestCandidate();
+	GLog->Log("--------------------------------------------------------------------");
+	GLog->Log("Sweep results of profile: " + ProfileName);
+	for (const FSRSweepCandidate& Candidate : Candidates)
+	{
+		GLog->Log(FString::Printf(TEXT("%s%s | accuracy: %f | training: %.1fs | inference FLOPs: %lld | %s"), &Candidate == Best ? TEXT("* ") : TEXT("  "),
+			*Candidate.GetLabel(), Candidate.Accuracy, Candidate.TrainSeconds, Candidate.InferenceFlops, Candidate.bPassed ? TEXT("passed") : TEXT("failed")));
+	}
+	GLog->Log("--------------------------------------------------------------------");
+}
@@ -1,127 +1,514 @@
 // Copyright 2019 Piotr Macharzewski. All Rights Reserved.
 #include "SRNetworkTrainingAsyncTask.h"
 #include "SRNeuralNetwork.h"
+#include "SRTrainingJob.h"
+#include "SRTrainingCheckpoint.h"
+#include "SymbolRecognizer.h"
+#include "Async/Async.h"
+#include "SymbolRecognizerPluginEditor.h"
+#include "Misc/FileHelper.h"
+#include "HAL/FileManager.h"
+#include "Misc/DateTime.h"
 
-FThreadSafeBool NetworkTrainingAsyncTask::bShouldStopSymbolTraining = false;
-float NetworkTrainingAsyncTask::Progress = 0.0f;
-int32 NetworkTrainingAsyncTask::CurrentEpochs = 0;
-TArray<float> NetworkTrainingAsyncTask::SymbolsScores = {};
-
-NetworkTrainingAsyncTask::NetworkTrainingAsyncTask(FSRNeuralNetwork& InNeuralItem, TArray<FSRTrainingDataSet>& InTrainigsSet, int32 InSymbolsCount, int32 InAllImagesCount, uint32 InInputs, uint32 InHidden, float InLr, int32 InEpochsLimit, float InAcceptableAccuracy, float InDeltaBestAnswers, FTrainingTaskCompleteDelegate InTrainingTaskComplete, FTrainingTaskStopDelegate InTrainingTaskStop)
-	: NeuralItem(InNeuralItem)
-	, TrainigsSet(InTrainigsSet)
-	, Outputs(InSymbolsCount)
-	, AllImagesCount(InAllImagesCount)
-	, Inputs(InInputs)
-	, Hidden(InHidden)
-	, Lr(InLr)
-	, EpochsLimit(InEpochsLimit)
-	, AcceptableAccuracy(InAcceptableAccuracy)
-	, DeltaBestAnswers(InDeltaBestAnswers)
-	, TrainingTaskComplete(InTrainingTaskComplete)
-	, TrainingTaskStop(InTrainingTaskStop)
-{
-	Progress = 0.0f;
-	bShouldStopSymbolTraining = false;
-	CurrentEpochs = 0;
-	SymbolsScores.Reset();
-	SymbolsScores.Reserve(InSymbolsCount + 1);
-	for (int32 I = 0; I < InSymbolsCount; ++I)
-		SymbolsScores.Emplace(0);
-		
+NetworkTrainingAsyncTask::NetworkTrainingAsyncTask(const TSharedRef<FSRTrainingJob, ESPMode::ThreadSafe>& InJob)
+	: Job(InJob)
+	, Pool(FSRTrainingThreadPool::Get())
+	, NeuralItem(InJob->Network)
+	, CascadeItem(InJob->bUseCascade ? &InJob->CascadeNetwork : nullptr)
+	, CascadeHidden(InJob->CascadeHiddenNodes)
+	, bTrainOutputLayerOnly(InJob->bTrainOutputLayerOnly)
+	, Parallelism(InJob->Parallelism)
+	, ThreadsCount(InJob->ThreadsCount > 0 ? InJob->ThreadsCount : FPlatformMisc::NumberOfCoresIncludingHyperthreads())
+	, BatchSize(FMath::Max(1, InJob->BatchSize))
+	, SamplingMode(InJob->SamplingMode)
+	, RandomSeed(InJob->RandomSeed)
+	, TrainigsSet(*InJob->TrainingSets)
+	, Outputs(InJob->SymbolsCount)
+	, AllImagesCount(InJob->ImagesCount)
+	, Hidden(InJob->HiddenNodes)
+	, EpochsLimit(InJob->EpochsLimit)
+	, AcceptableAccuracy(InJob->AcceptableAccuracy)
+	, DeltaBestAnswers(InJob->DeltaBestAnswers)
+	, EvaluationInterval(FMath::Max(1, InJob->EvaluationInterval))
+	, CheckpointInterval(InJob->CheckpointInterval)
+{
+	SymbolsScores.Init(0.0f, Outputs);
+	if (Job->ResumeCheckpoint.IsValid() && Job->ResumeCheckpoint->SymbolsScores.Num() == Outputs)
+		SymbolsScores = Job->ResumeCheckpoint->SymbolsScores;
+	Job->ReportProgress(0.0f, Job->ResumeCheckpoint.IsValid() ? Job->ResumeCheckpoint->Epochs : 0, SymbolsScores);
+
+	//stratified subsample, images spread evenly over every symbol.
+	const float SampleRatio = FMath::Clamp(InJob->EvaluationSampleRatio, 0.0f, 1.0f);
+	EvaluationSamplesPerSet.Init(0, TrainigsSet.Num());
+	for (int32 SetIdx = 0; SetIdx < TrainigsSet.Num(); ++SetIdx)
+	{
+		const int32 ImagesCount = TrainigsSet[SetIdx].Inputs.Num();
+		const int32 SamplesCount = FMath::Min(ImagesCount, FMath::Max(1, FMath::CeilToInt(ImagesCount * SampleRatio)));
+		for (int32 Sample = 0; Sample < SamplesCount; ++Sample)
+			EvaluationSamples.Emplace(SetIdx, (int32)((int64)Sample * ImagesCount / SamplesCount));
+
+		EvaluationSamplesPerSet[SetIdx] = SamplesCount;
+	}
 }
 
-void NetworkTrainingAsyncTask::DoWork()
+void NetworkTrainingAsyncTask::SaveCheckpoint(int32 InEpochs) const
 {
-	int32 Epochs = 0;
-	bool bAutoTraining = EpochsLimit <= 0;
-	if (bAutoTraining)
+	FSRTrainingCheckpoint Checkpoint;
+	Checkpoint.ProfileName = Job->ProfileName;
+	Checkpoint.ParamsHash = Job->ParamsHash;
+	Checkpoint.Epochs = InEpochs;
+	Checkpoint.Network = NeuralItem;
+	if (CascadeItem)
+		Checkpoint.CascadeNetwork = *CascadeItem;
+	Sampler.GetState(Checkpoint.SamplerSeed, Checkpoint.SamplesHardness);
+	Checkpoint.SymbolsScores = SymbolsScores;
+	Checkpoint.Save();
+}
+
+void NetworkTrainingAsyncTask::PublishStats(bool bAutoTraining)
+{
+	Stats.SamplesPerSecond = Stats.EpochSeconds > 0.0 ? (float)(Stats.EpochSamples / Stats.EpochSeconds) : 0.0f;
+	Stats.TrainSecondsPerSample = Stats.EpochSamples > 0 ? Stats.TrainSeconds / Stats.EpochSamples : 0.0;
+
+	Stats.EstimatedSecondsLeft = -1.0;
+	if (!bAutoTraining)
 	{
-		EpochsLimit = 3;
+		Stats.EstimatedSecondsLeft = FMath::Max(0, EpochsLimit - Stats.Epochs) * Stats.EpochSeconds;
+	}
+	else if (PreviousAccuracy >= 0.0f && Stats.Accuracy > PreviousAccuracy && Stats.EvaluatedEpochs > PreviousEvaluatedEpochs)
+	{
+		//linear extrapolation of accuracy gain between the last two evaluations.
+		const double GainPerEpoch = (Stats.Accuracy - PreviousAccuracy) / (Stats.EvaluatedEpochs - PreviousEvaluatedEpochs);
+		const double EpochsLeft = FMath::Max(0.0, (AcceptableAccuracy - Stats.Accuracy) / GainPerEpoch);
+		Stats.EstimatedSecondsLeft = EpochsLeft * Stats.EpochSeconds;
 	}
 
-	while (Epochs < EpochsLimit)
+	Job->SetStats(Stats);
+	WriteStatsCsv();
+}
+
+void NetworkTrainingAsyncTask::WriteStatsCsv() const
+{
+	if (StatsCsvPath.IsEmpty())
 	{
-		Epochs++;
-		CurrentEpochs = Epochs;
+		return;
+	}
 
-		if (bShouldStopSymbolTraining)
+	FString Line;
+	if (!IFileManager::Get().FileExists(*StatsCsvPath))
+	{
+		Line += "Time,Profile,CPU,Cores,Parallelism,Threads,BatchSize,Sampling,Epoch,EpochSamples,EpochSeconds,SamplesPerSecond,TrainSeconds,"
+			"TrainMicrosecondsPerSample,ForwardMicrosecondsPerSample,EvaluationSeconds,EvaluationWaitSeconds,EvaluatedEpoch,Loss,Accuracy,EstimatedSecondsLeft\n";
+	}
+
+	const UEnum* ParallelismEnum = StaticEnum<ESRTrainingParallelism>();
+	const UEnum* SamplingEnum = StaticEnum<ESRSamplingMode>();
+	Line += FString::Printf(TEXT("%s,%s,\"%s\",%i,%s,%i,%i,%s,%i,%i,%f,%f,%f,%f,%f,%f,%f,%i,%f,%f,%f\n"),
+		*FDateTime::Now().ToString(), *Job->GetDisplayName(), *FPlatformMisc::GetCPUBrand().TrimStartAndEnd(), FPlatformMisc::NumberOfCoresIncludingHyperthreads(),
+		*ParallelismEnum->GetNameStringByValue((int64)Parallelism), Parallelism == ESRTrainingParallelism::SingleThread ? 1 : ThreadsCount, BatchSize,
+		*SamplingEnum->GetNameStringByValue((int64)SamplingMode), Stats.Epochs, Stats.EpochSamples, Stats.EpochSeconds, Stats.SamplesPerSecond, Stats.TrainSeconds,
+		Stats.TrainSecondsPerSample * 1000000.0, Stats.ForwardSecondsPerSample * 1000000.0, Stats.EvaluationSeconds, Stats.EvaluationWaitSeconds,
+		Stats.EvaluatedEpochs, Stats.Loss, Stats.Accuracy, Stats.EstimatedSecondsLeft);
+
+	FFileHelper::SaveStringToFile(Line, *StatsCsvPath, FFileHelper::EEncodingOptions::ForceAnsi, &IFileManager::Get(), FILEWRITE_Append);
+}
+
+TFuture<FSREvaluationResult> NetworkTrainingAsyncTask::StartEvaluation(int32 InEpochs) const
+{
+	TSharedPtr<FSRNeuralNetwork, ESPMode::ThreadSafe> Snapshot = MakeShared<FSRNeuralNetwork, ESPMode::ThreadSafe>(NeuralItem);
+	//own thread: GThreadPool is shared with the editor, and queued on the training pool it could wait behind the training waiting for it.
+	return Async(EAsyncExecution::Thread, [this, Snapshot, InEpochs]()
+	{
+		return Evaluate(Snapshot, InEpochs);
+	});
+}
+
+FSREvaluationResult NetworkTrainingAsyncTask::Evaluate(const TSharedPtr<FSRNeuralNetwork, ESPMode::ThreadSafe>& InSnapshot, int32 InEpochs) const
+{
+	FSREvaluationResult Result;
+	Result.Snapshot = InSnapshot;
+	Result.Epochs = InEpochs;
+	Result.SymbolsScores.Init(0.0f, Outputs);
+
+	const double StartTime = FPlatformTime::Seconds();
+	const bool bMeasureHardness = Sampler.NeedsHardness();
+	if (bMeasureHardness)
+		Result.Hardness.Init(ESRSampleHardness::Unknown, EvaluationSamples.Num());
+
+	//fixed chunks (not cores count), so loss is the same on every machine; counts are integers anyway.
+	const int32 ChunksCount = FMath::Clamp((int32)EvaluationChunks, 1, FMath::Max(1, EvaluationSamples.Num()));
+	TArray<TArray<int32>> GoodAnswersPerChunk;
+	GoodAnswersPerChunk.SetNum(ChunksCount);
+	TArray<double> LossPerChunk;
+	LossPerChunk.Init(0.0, ChunksCount);
+	TArray<double> ForwardSecondsPerChunk;
+	ForwardSecondsPerChunk.Init(0.0, ChunksCount);
+	Pool.ParallelFor(ChunksCount, [&](int32 Chunk)
+	{
+		TArray<int32>& GoodAnswers = GoodAnswersPerChunk[Chunk];
+		GoodAnswers.Init(0, TrainigsSet.Num());
+		for (int32 SampleIdx = Chunk; SampleIdx < EvaluationSamples.Num(); SampleIdx += ChunksCount)
 		{
-			TrainingTaskStop.ExecuteIfBound();
-			GLog->Log("--------------------------------------------------------------------");
-			GLog->Log("TASK BROKEN");
-			GLog->Log("--------------------------------------------------------------------");
-			return;
+			const FSRTrainingDataSet& TrainingSet = TrainigsSet[EvaluationSamples[SampleIdx].Key];
+			const double QueryStartTime = FPlatformTime::Seconds();
+			const FSRDMatrix Output = InSnapshot->Query(TrainingSet.Inputs[EvaluationSamples[SampleIdx].Value]);
+			ForwardSecondsPerChunk[Chunk] += FPlatformTime::Seconds() - QueryStartTime;
+			GoodAnswers[EvaluationSamples[SampleIdx].Key] += FSRNeuralNetwork::GetQueryResult(Output, TrainingSet.Answer, AcceptableAccuracy, DeltaBestAnswers);
+			for (int32 OutputIdx = 0; OutputIdx < Output.R.Num() && OutputIdx < TrainingSet.ExpectedOutput.Num(); ++OutputIdx)
+				LossPerChunk[Chunk] += FMath::Square(TrainingSet.ExpectedOutput[OutputIdx] - Output.R[OutputIdx].C[0]);
+			if (bMeasureHardness)
+				Result.Hardness[SampleIdx] = FSREpochSampler::GetHardness(Output, TrainingSet.Answer, AcceptableAccuracy, DeltaBestAnswers);
 		}
+	});
+
+	int32 GoodAnswersCount = 0;
+	for (int32 SetIdx = 0; SetIdx < TrainigsSet.Num(); ++SetIdx)
+	{
+		int32 GoodAnswersPerSymbol = 0;
+		for (const TArray<int32>& GoodAnswers : GoodAnswersPerChunk)
+			GoodAnswersPerSymbol += GoodAnswers[SetIdx];
+
+		if (Result.SymbolsScores.IsValidIndex(SetIdx))
+			Result.SymbolsScores[SetIdx] = (EvaluationSamplesPerSet[SetIdx] > 0) ? GoodAnswersPerSymbol / (float)EvaluationSamplesPerSet[SetIdx] : 0.0f;
+		GoodAnswersCount += GoodAnswersPerSymbol;
+	}
+	Result.Accuracy = EvaluationSamples.Num() > 0 ? GoodAnswersCount / (float)EvaluationSamples.Num() : 0.0f;
 
-		for (FSRTrainingDataSet& trainingSet : TrainigsSet)
+	//summed in chunks order, so the same chunks give the same loss.
+	double Loss = 0.0;
+	for (double ChunkLoss : LossPerChunk)
+		Loss += ChunkLoss;
+	Result.Loss = (EvaluationSamples.Num() > 0 && Outputs > 0) ? (float)(Loss / ((double)EvaluationSamples.Num() * Outputs)) : 0.0f;
+	Result.Seconds = FPlatformTime::Seconds() - StartTime;
+	for (double ChunkSeconds : ForwardSecondsPerChunk)
+		Result.ForwardSeconds += ChunkSeconds;
+
+	return Result;
+}
+
+void NetworkTrainingAsyncTask::ReportEvaluation(const FSREvaluationResult& InResult, bool bAutoTraining, int32 InEpochs)
+{
+	SymbolsScores = InResult.SymbolsScores;
+	PreviousAccuracy = Stats.EvaluatedEpochs > 0 ? Stats.Accuracy : -1.0f;
+	PreviousEvaluatedEpochs = Stats.EvaluatedEpochs;
+	Stats.EvaluatedEpochs = InResult.Epochs;
+	Stats.Accuracy = InResult.Accuracy;
+	Stats.Loss = InResult.Loss;
+	Stats.EvaluationSeconds = InResult.Seconds;
+	if (EvaluationSamples.Num() > 0)
+		Stats.ForwardSecondsPerSample = InResult.ForwardSeconds / EvaluationSamples.Num();
+
+	GLog->Log("Accuracy: " + FString::SanitizeFloat(InResult.Accuracy) + " -- epochs: " + FString::FromInt(InResult.Epochs) + " AcceptableAccuracy: " + FString::SanitizeFloat(AcceptableAccuracy)
+		+ " Loss: " + FString::SanitizeFloat(InResult.Loss));
+
+	const float Progress = bAutoTraining ? InResult.Accuracy / AcceptableAccuracy : InEpochs / (float)EpochsLimit;
+	Job->ReportProgress(Progress, InEpochs, SymbolsScores);
+}
+
+bool NetworkTrainingAsyncTask::IsStopRequested() const
+{
+	return Job->IsStopRequested();
+}
+
+void NetworkTrainingAsyncTask::WaitWhilePaused() const
+{
+	Pool.WaitWhilePaused([this]() { return IsStopRequested(); });
+}
+
+void NetworkTrainingAsyncTask::BreakTask()
+{
+	Job->SetState(ESRTrainingJobState::Stopped);
+	Job->OnStop.ExecuteIfBound();
+	GLog->Log("--------------------------------------------------------------------");
+	GLog->Log("TASK BROKEN");
+	GLog->Log("--------------------------------------------------------------------");
+}
+
+void NetworkTrainingAsyncTask::BuildPrunedNetwork()
+{
+	if (Job->PrunedHiddenRatio <= 0.0f)
+		return;
+
+	TArray<TArray<float>> CalibrationInputs;
+	Job->CollectCalibrationInputs(CalibrationInputs);
+	Job->PrunedAgreementRate = USymbolRecognizer::MakePrunedNetwork(NeuralItem, CalibrationInputs, Job->PrunedHiddenRatio, Job->PrunedNetwork);
+}
+
+void NetworkTrainingAsyncTask::TrainCascade(const TArray<float>& InInput, const TArray<float>& InExpectedOutput)
+{
+	if (CascadeItem)
+	{
+		if (CascadeItem->bIsTrained == false)
+			*CascadeItem = NeuralItem.MakeUntrained(CascadeHidden);
+
+		CascadeItem->Train(InInput, InExpectedOutput);
+	}
+}
+
+bool NetworkTrainingAsyncTask::TrainEpochSingleThread()
+{
+	for (const TPair<int32, int32>& Sample : SamplesOrder)
+	{
+		WaitWhilePaused();
+		if (IsStopRequested())
 		{
-			for (TArray<float>& trainingData : trainingSet.Inputs)
-			{
-				if (bShouldStopSymbolTraining)
-				{
-					TrainingTaskStop.ExecuteIfBound();
-					GLog->Log("--------------------------------------------------------------------");
-					GLog->Log("TASK BROKEN");
-					GLog->Log("--------------------------------------------------------------------");
-					return;
-				}
-				//...
+			return false;
+		}
 
-				if (NeuralItem.bIsTrained == false)//initialize all necessary params if it was not in training before.
-					NeuralItem = FSRNeuralNetwork(Inputs, Hidden, Outputs, Lr);
+		const FSRTrainingDataSet& trainingSet = TrainigsSet[Sample.Key];
+		const TArray<float>& trainingData = GetTrainingInput(Sample);
 
-				NeuralItem.Train(trainingData, trainingSet.ExpectedOutput);
+		if (bTrainOutputLayerOnly)
+		{
+			NeuralItem.TrainOutputLayer(trainingData, trainingSet.ExpectedOutput);
+		}
+		else
+		{
+			if (NeuralItem.bIsTrained == false)//initialize all necessary params if it was not in training before.
+				NeuralItem = NeuralItem.MakeUntrained(Hidden);
 
-			}
+			NeuralItem.Train(trainingData, trainingSet.ExpectedOutput);
 		}
 
+		TrainCascade(trainingData, trainingSet.ExpectedOutput);
+	}
+
+	return true;
+}
+
+bool NetworkTrainingAsyncTask::TrainEpochDataParallel()
+{
+	//samples are summed into a fixed number of slots and slots in fixed order, so weights are the same with any ThreadsCount.
+	const int32 SlotsCount = FMath::Min(BatchSize, (int32)MaxGradientSlots);
+	if (GradientBuffers.Num() != SlotsCount)
+	{
+		GradientBuffers.SetNum(SlotsCount);
+		for (FSRGradientBuffer& Buffer : GradientBuffers)
+			Buffer.Init(NeuralItem);
+	}
 
-		//calculate training progress by comparing good answers ratio.
-		float GoodAnswersCount = 0;
-		for (int32 SymbolIdx = 0; SymbolIdx < TrainigsSet.Num(); ++SymbolIdx)
-			//for (FSRTrainingDataSet& trainingSet : TrainigsSet)
+	for (int32 BatchStart = 0; BatchStart < SamplesOrder.Num(); BatchStart += BatchSize)
+	{
+		WaitWhilePaused();
+		if (IsStopRequested())
 		{
-			int32 GoodAnswersPerSymbol = 0;
-			for (TArray<float>& trainingData : TrainigsSet[SymbolIdx].Inputs)
+			return false;
+		}
+
+		const int32 BatchEnd = FMath::Min(BatchStart + BatchSize, SamplesOrder.Num());
+		Pool.ParallelFor(SlotsCount, [&](int32 Slot)
+		{
+			FSRGradientBuffer& Buffer = GradientBuffers[Slot];
+			Buffer.Reset();
+			for (int32 SampleIdx = BatchStart + Slot; SampleIdx < BatchEnd; SampleIdx += SlotsCount)
 			{
-				GoodAnswersPerSymbol += FSRNeuralNetwork::GetQueryResult(NeuralItem, trainingData, TrainigsSet[SymbolIdx].Answer, AcceptableAccuracy, DeltaBestAnswers);
+				const FSRTrainingDataSet& TrainingSet = TrainigsSet[SamplesOrder[SampleIdx].Key];
+				NeuralItem.AccumulateGradients(GetTrainingInput(SamplesOrder[SampleIdx]), TrainingSet.ExpectedOutput, Buffer, bTrainOutputLayerOnly);
 			}
+		}, ThreadsCount);
+
+		//reduce to the first buffer, every thread sums its own range of weights (each weight still in slots order).
+		const int32 ChunkSize = FMath::DivideAndRoundUp(GradientBuffers[0].Num(), ThreadsCount);
+		Pool.ParallelFor(ThreadsCount, [&](int32 Chunk)
+		{
+			for (int32 Slot = 1; Slot < SlotsCount; ++Slot)
+				GradientBuffers[0].Add(GradientBuffers[Slot], Chunk * ChunkSize, (Chunk + 1) * ChunkSize);
+		});
+
+		//averaged gradients with learning rate scaled by sqrt of batch size, so the step stays close to per-sample training.
+		const float BatchSamples = (float)(BatchEnd - BatchStart);
+		NeuralItem.ApplyGradients(GradientBuffers[0], NeuralItem.LearningRate * FMath::Sqrt(BatchSamples) / BatchSamples, bTrainOutputLayerOnly);
+
+		for (int32 SampleIdx = BatchStart; SampleIdx < BatchEnd; ++SampleIdx)
+		{
+			const FSRTrainingDataSet& TrainingSet = TrainigsSet[SamplesOrder[SampleIdx].Key];
+			TrainCascade(GetTrainingInput(SamplesOrder[SampleIdx]), TrainingSet.ExpectedOutput);
+		}
+	}
+
+	return true;
+}
+
+bool NetworkTrainingAsyncTask::TrainEpochHogwild()
+{
+	//threads read and write shared weights without synchronization, updates of single samples are sparse enough to mostly not collide.
+	Pool.ParallelFor(ThreadsCount, [&](int32 Thread)
+	{
+		for (int32 SampleIdx = Thread; SampleIdx < SamplesOrder.Num() && !IsStopRequested(); SampleIdx += ThreadsCount)
+		{
+			WaitWhilePaused();
+			const FSRTrainingDataSet& TrainingSet = TrainigsSet[SamplesOrder[SampleIdx].Key];
+			if (bTrainOutputLayerOnly)
+				NeuralItem.TrainOutputLayer(GetTrainingInput(SamplesOrder[SampleIdx]), TrainingSet.ExpectedOutput);
+			else
+				NeuralItem.Train(GetTrainingInput(SamplesOrder[SampleIdx]), TrainingSet.ExpectedOutput);
+		}
+	});
+
+	if (IsStopRequested())
+	{
+		return false;
+	}
+
+	for (const TPair<int32, int32>& Sample : SamplesOrder)
+		TrainCascade(GetTrainingInput(Sample), TrainigsSet[Sample.Key].ExpectedOutput);
+
+	return true;
+}
+
+void NetworkTrainingAsyncTask::DoWork()
+{
+	int32 Epochs = 0;
+	bool bAutoTraining = EpochsLimit <= 0;
+	const int32 MinEpochs = bAutoTraining ? 3 : EpochsLimit;
+
+	if (Parallelism == ESRTrainingParallelism::DataParallel && NeuralItem.IsHierarchical())
+	{
+		GLog->Log("Two-level output layer can't be trained in DataParallel mode, training on a single thread.");
+		Parallelism = ESRTrainingParallelism::SingleThread;
+	}
+
+	//parallel modes interleave symbols in sequential order, so every batch (or thread) gets a mix of them.
+	TArray<int32> SamplesPerSet;
+	for (const FSRTrainingDataSet& TrainingSet : TrainigsSet)
+		SamplesPerSet.Add(TrainingSet.Inputs.Num());
+	Sampler.Init(SamplesPerSet, SamplingMode, Parallelism != ESRTrainingParallelism::SingleThread, RandomSeed);
+
+	if (Job->ResumeCheckpoint.IsValid())
+	{
+		Epochs = Job->ResumeCheckpoint->Epochs;
+		Sampler.SetState(Job->ResumeCheckpoint->SamplerSeed, Job->ResumeCheckpoint->SamplesHardness);
+		GLog->Log("Training resumed from checkpoint, epochs: " + FString::FromInt(Epochs));
+	}
+
+	//parallel modes need initialized weights before threads start.
+	if (Parallelism != ESRTrainingParallelism::SingleThread && !bTrainOutputLayerOnly && NeuralItem.bIsTrained == false)
+		NeuralItem = NeuralItem.MakeUntrained(Hidden);
+
+	StatsCsvPath = FSymbolRecognizerPluginEditorModule::GetPluginDir() / "Saved/TrainingStats" / Job->ProfileName + ".csv";
+	Augmentation.Init(TrainigsSet, Job->Augmentation, RandomSeed, Pool);
+
+	//evaluation of the previous snapshot runs while next epoch is trained.
+	TFuture<FSREvaluationResult> PendingEvaluation;
+	while (true)
+	{
+		Epochs++;
+		const double EpochStartTime = FPlatformTime::Seconds();
+		const double PausedSecondsAtStart = Pool.GetPausedSeconds();
+		//next epoch's inputs are prepared while this one trains.
+		Stats.AugmentationWaitSeconds = Augmentation.BeginEpoch(Epochs);
+		if (SamplingMode != ESRSamplingMode::Sequential || SamplesOrder.Num() == 0)
+			Sampler.BuildEpoch(SamplesOrder);
 
-			SymbolsScores[SymbolIdx] = GoodAnswersPerSymbol / (float)TrainigsSet[SymbolIdx].Inputs.Num();
-			GoodAnswersCount += GoodAnswersPerSymbol;
+		const double TrainStartTime = FPlatformTime::Seconds();
+
+		bool bEpochFinished;
+		switch (Parallelism)
+		{
+		case ESRTrainingParallelism::DataParallel:
+			bEpochFinished = TrainEpochDataParallel();
+			break;
+		case ESRTrainingParallelism::Hogwild:
+			bEpochFinished = TrainEpochHogwild();
+			break;
+		default:
+			bEpochFinished = TrainEpochSingleThread();
+			break;
 		}
 
-		float Accuracy = GoodAnswersCount / AllImagesCount;
-		FString AccuracyStr = FString::SanitizeFloat(Accuracy) + " -- epochs: " + FString::FromInt(Epochs);
+		//time of pause is not counted into speed of training.
+		Stats.TrainSeconds = FPlatformTime::Seconds() - TrainStartTime - (Pool.GetPausedSeconds() - PausedSecondsAtStart);
+		Stats.EpochSamples = SamplesOrder.Num();
 
-		GLog->Log("Accuracy: " + AccuracyStr + " AcceptableAccuracy: " + FString::SanitizeFloat(AcceptableAccuracy));
+		if (!bEpochFinished)
+		{
+			//evaluation task uses this task's data.
+			if (PendingEvaluation.IsValid())
+				PendingEvaluation.Wait();
 
-		if (bAutoTraining)
+			//nothing is saved here: weights and sampler already hold part of this epoch, resume continues from the last periodic checkpoint.
+			if (Job->ShouldSaveOnStop())
+				BuildPrunedNetwork();
+
+			BreakTask();
+			return;
+		}
+
+		Stats.EvaluationWaitSeconds = 0.0;
+		TSharedPtr<FSRNeuralNetwork, ESPMode::ThreadSafe> AcceptedSnapshot;
+		if (PendingEvaluation.IsValid())
 		{
-			//Progress is static var.
-			Progress = (Accuracy / AcceptableAccuracy);
+			const double WaitStartTime = FPlatformTime::Seconds();
+			PendingEvaluation.Wait();
+			Stats.EvaluationWaitSeconds = FPlatformTime::Seconds() - WaitStartTime;
 
-			if (Accuracy < AcceptableAccuracy)
-			{
-				EpochsLimit += 1;
-			}
+			const FSREvaluationResult Result = PendingEvaluation.Get();
+			PendingEvaluation = TFuture<FSREvaluationResult>();
+			ReportEvaluation(Result, bAutoTraining, Epochs);
+			for (int32 SampleIdx = 0; SampleIdx < Result.Hardness.Num(); ++SampleIdx)
+				Sampler.SetHardness(EvaluationSamples[SampleIdx].Key, EvaluationSamples[SampleIdx].Value, Result.Hardness[SampleIdx]);
+			Job->Mailbox->Publish(*Result.Snapshot);
+
+			if (bAutoTraining && Result.Epochs >= MinEpochs && Result.Accuracy >= AcceptableAccuracy)
+				AcceptedSnapshot = Result.Snapshot;
 		}
-		else
+		else if (!bAutoTraining)
+		{
+			Job->ReportProgress(Epochs / (float)EpochsLimit, Epochs, SymbolsScores);
+		}
+
+		Stats.Epochs = Epochs;
+		Stats.EpochSeconds = FPlatformTime::Seconds() - EpochStartTime - (Pool.GetPausedSeconds() - PausedSecondsAtStart);
+		Stats.TotalSeconds += Stats.EpochSeconds;
+		PublishStats(bAutoTraining);
+
+		//keep the weights that were measured, not the ones trained after them.
+		if (AcceptedSnapshot.IsValid())
 		{
-			//Progress is static var.
-			Progress = (Epochs / (float)EpochsLimit);
-			//GLog->Log("Progress: " + FString::FromInt(Epochs) + "/" + FString::FromInt(EpochsLimit));
+			NeuralItem = *AcceptedSnapshot;
+			break;
+		}
+
+		if (!bAutoTraining && Epochs >= EpochsLimit)
+		{
+			break;
+		}
+
+		if (Epochs % EvaluationInterval == 0 || (bAutoTraining && Epochs == MinEpochs))
+		{
+			PendingEvaluation = StartEvaluation(Epochs);
+		}
+
+		if (CheckpointInterval > 0 && Epochs % CheckpointInterval == 0)
+		{
+			SaveCheckpoint(Epochs);
 		}
 	}
 
+	if (PendingEvaluation.IsValid())
+		PendingEvaluation.Wait();
 
+	//final scores of the saved network.
+	if (!bAutoTraining)
+	{
+		ReportEvaluation(Evaluate(MakeShared<FSRNeuralNetwork, ESPMode::ThreadSafe>(NeuralItem), Epochs), bAutoTraining, Epochs);
+		Stats.EstimatedSecondsLeft = 0.0;
+		Job->SetStats(Stats);
+	}
 
 	GLog->Log("--------------------------------------------------------------------");
 	GLog->Log("End of NetworkTrainingAsyncTask calculation on background thread");
 	GLog->Log("--------------------------------------------------------------------");
 
-	TrainingTaskComplete.ExecuteIfBound();
+	Stats.WeightsCrc = NeuralItem.GetWeightsCrc();
+	Job->SetStats(Stats);
+	GLog->Log(FString::Printf(TEXT("Network weights CRC: %08X (seed: %i)"), Stats.WeightsCrc, RandomSeed));
+
+	BuildPrunedNetwork();
+
+	Job->Mailbox->Publish(NeuralItem);
+	Job->SetState(ESRTrainingJobState::Completed);
+	Job->OnComplete.ExecuteIfBound();
 }
 
 
@@ -349,6 +349,18 @@ TSharedRef<SWidget> SRPreviewPanel::BuildTrainingSeciton()
 			]
 
 		]
+		+ SHorizontalBox::Slot().Padding(5, 5)
+		.AutoWidth()
+		.VAlign(VAlign_Top)
+		[
+			ADD_SPECIAL_BUTTON("LEARN ALL PROFILES", 150, 30, &SRPreviewPanel::OnTrainAllProfiles, "- Queues training of every profile with all images drawn.\n - Trainings run at the same time as long as they fit into TrainingCoresBudget.")
+		]
+		+ SHorizontalBox::Slot().Padding(5,5)
+		.AutoWidth()
+		.VAlign(VAlign_Top)
+		[
+			ADD_SPECIAL_BUTTON("SWEEP PARAMS", 120, 30, &SRPreviewPanel::OnSweepParams, "- Trains configurations from SweepSettings at the same time.\n - Saves the network that is the cheapest to query among the ones reaching AcceptableTrainingAccuracy\n   and sets its HiddenNodes, LearningRate and LearningCycles in the profile.\n - Results are printed to the log.")
+		]
 		+ SHorizontalBox::Slot().Padding(5,5)
 		.AutoWidth()
 		.VAlign(VAlign_Top)
@@ -445,6 +457,27 @@ FReply SRPreviewPanel::OnTrainNetwork()
 	return FReply::Handled();
 }
 
+FReply SRPreviewPanel::OnTrainAllProfiles()
+{
+	ToolKit->TrainAllProfiles();
+
+	return FReply::Handled();
+}
+
+FReply SRPreviewPanel::OnSweepParams()
+{
+	if (ToolKit->Validate_AllImagesDrawn() == false)
+	{
+		SRPopup::ShowTutorial(ToolKit.Get(), 2);
+	}
+	else
+	{
+		ToolKit->StartSweep();
+	}
+
+	return FReply::Handled();
+}
+
 FReply SRPreviewPanel::OnSaveClick()
 {
 	ToolKit->SaveImage(CurrentSymbolData.SymbolId, CurrentImageItem.ImgId);
@@ -0,0 +1,243 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#include "SRSampleAugmenter.h"
+#include "SRNetworkTrainingAsyncTask.h"
+#include "SRTrainingThreadPool.h"
+#include "SRStrokeEncoder.h"
+#include "Async/Async.h"
+#include "Math/RandomStream.h"
+
+/*
+ * Random affine transform and smooth displacement field in normalized (0-1) image space.
+ */
+struct FSRAugmentTransform
+{
+	//control points of the displacement field, bilinear between them.
+	static const int32 ElasticGrid = 4;
+
+	float M[4];
+	float InvM[4];
+	FVector2D Shift;
+	FVector2D Displacements[ElasticGrid * ElasticGrid];
+
+	FSRAugmentTransform(const FSRAugmentationSettings& InSettings, FRandomStream& InRandom)
+	{
+		const float Angle = FMath::DegreesToRadians(InRandom.FRandRange(-InSettings.Rotation, InSettings.Rotation));
+		const float Scale = 1.0f + InRandom.FRandRange(-InSettings.Scale, InSettings.Scale);
+		const float Shear = InRandom.FRandRange(-InSettings.Shear, InSettings.Shear);
+		float Sin, Cos;
+		FMath::SinCos(&Sin, &Cos, Angle);
+
+		//rotation * [Scale Shear; 0 Scale]
+		M[0] = Cos * Scale;
+		M[1] = Cos * Shear - Sin * Scale;
+		M[2] = Sin * Scale;
+		M[3] = Sin * Shear + Cos * Scale;
+		const float InvDet = 1.0f / (M[0] * M[3] - M[1] * M[2]);
+		InvM[0] = M[3] * InvDet;
+		InvM[1] = -M[1] * InvDet;
+		InvM[2] = -M[2] * InvDet;
+		InvM[3] = M[0] * InvDet;
+
+		Shift.X = InRandom.FRandRange(-InSettings.Shift, InSettings.Shift);
+		Shift.Y = InRandom.FRandRange(-InSettings.Shift, InSettings.Shift);
+		for (FVector2D& Displacement : Displacements)
+		{
+			Displacement.X = InRandom.FRandRange(-InSettings.Elastic, InSettings.Elastic);
+			Displacement.Y = InRandom.FRandRange(-InSettings.Elastic, InSettings.Elastic);
+		}
+	}
+
+	FVector2D GetDisplacement(const FVector2D& InUV) const
+	{
+		const float X = FMath::Clamp(InUV.X, 0.0f, 1.0f) * (ElasticGrid - 1);
+		const float Y = FMath::Clamp(InUV.Y, 0.0f, 1.0f) * (ElasticGrid - 1);
+		const int32 X0 = FMath::Min((int32)X, ElasticGrid - 2);
+		const int32 Y0 = FMath::Min((int32)Y, ElasticGrid - 2);
+		const float FracX = X - X0;
+		const float FracY = Y - Y0;
+		const FVector2D Top = FMath::Lerp(Displacements[Y0 * ElasticGrid + X0], Displacements[Y0 * ElasticGrid + X0 + 1], FracX);
+		const FVector2D Bottom = FMath::Lerp(Displacements[(Y0 + 1) * ElasticGrid + X0], Displacements[(Y0 + 1) * ElasticGrid + X0 + 1], FracX);
+		return FMath::Lerp(Top, Bottom, FracY);
+	}
+
+	FVector2D Forward(const FVector2D& InUV) const
+	{
+		const FVector2D Centered = InUV - FVector2D(0.5f, 0.5f);
+		return FVector2D(M[0] * Centered.X + M[1] * Centered.Y, M[2] * Centered.X + M[3] * Centered.Y) + FVector2D(0.5f, 0.5f) + Shift + GetDisplacement(InUV);
+	}
+
+	//source of the output point InUV (displacement is small, so it is read at the output point).
+	FVector2D Inverse(const FVector2D& InUV) const
+	{
+		const FVector2D Centered = InUV - FVector2D(0.5f, 0.5f) - Shift - GetDisplacement(InUV);
+		return FVector2D(InvM[0] * Centered.X + InvM[1] * Centered.Y, InvM[2] * Centered.X + InvM[3] * Centered.Y) + FVector2D(0.5f, 0.5f);
+	}
+};
+
+void FSRSampleAugmenter::AugmentPixels(const TArray<float>& InPixels, TArray<float>& OutPixels, const FSRAugmentationSettings& InSettings, FRandomStream& InRandom)
+{
+	const int32 Size = FMath::RoundToInt(FMath::Sqrt((float)InPixels.Num()));
+	if (Size < 2 || Size * Size != InPixels.Num())
+	{
+		OutPixels = InPixels;
+		return;
+	}
+
+	//empty canvas value, see USRToolManager::LoadTrainDataFromTexture.
+	const float Background = 0.01f;
+	auto ReadPixel = [&InPixels, Size, Background](int32 X, int32 Y)
+	{
+		return (X < 0 || Y < 0 || X >= Size || Y >= Size) ? Background : InPixels[Y * Size + X];
+	};
+
+	const FSRAugmentTransform Transform(InSettings, InRandom);
+	OutPixels.SetNumUninitialized(InPixels.Num());
+	for (int32 Y = 0; Y < Size; ++Y)
+	{
+		for (int32 X = 0; X < Size; ++X)
+		{
+			const FVector2D Source = Transform.Inverse(FVector2D((X + 0.5f) / Size, (Y + 0.5f) / Size)) * Size - FVector2D(0.5f, 0.5f);
+			const int32 X0 = FMath::FloorToInt(Source.X);
+			const int32 Y0 = FMath::FloorToInt(Source.Y);
+			const float FracX = Source.X - X0;
+			const float FracY = Source.Y - Y0;
+			const float Top = FMath::Lerp(ReadPixel(X0, Y0), ReadPixel(X0 + 1, Y0), FracX);
+			const float Bottom = FMath::Lerp(ReadPixel(X0, Y0 + 1), ReadPixel(X0 + 1, Y0 + 1), FracX);
+			OutPixels[Y * Size + X] = FMath::Lerp(Top, Bottom, FracY);
+		}
+	}
+
+	//thicker strokes blend towards 3x3 max, thinner towards 3x3 min.
+	const float Thickness = InRandom.FRandRange(-InSettings.Thickness, InSettings.Thickness);
+	if (FMath::IsNearlyZero(Thickness))
+	{
+		return;
+	}
+
+	const TArray<float> Warped = OutPixels;
+	for (int32 Y = 0; Y < Size; ++Y)
+	{
+		for (int32 X = 0; X < Size; ++X)
+		{
+			float Extreme = Warped[Y * Size + X];
+			for (int32 OffsetY = FMath::Max(0, Y - 1); OffsetY <= FMath::Min(Size - 1, Y + 1); ++OffsetY)
+			{
+				for (int32 OffsetX = FMath::Max(0, X - 1); OffsetX <= FMath::Min(Size - 1, X + 1); ++OffsetX)
+				{
+					const float Value = Warped[OffsetY * Size + OffsetX];
+					Extreme = Thickness > 0.0f ? FMath::Max(Extreme, Value) : FMath::Min(Extreme, Value);
+				}
+			}
+
+			OutPixels[Y * Size + X] = FMath::Lerp(Warped[Y * Size + X], Extreme, FMath::Abs(Thickness));
+		}
+	}
+}
+
+bool FSRSampleAugmenter::AugmentStrokes(const TArray<FSRDrawLine>& InLines, TArray<float>& OutDescriptor, const FSRAugmentationSettings& InSettings, FRandomStream& InRandom)
+{
+	FBox2D Bounds(ForceInit);
+	for (const FSRDrawLine& Line : InLines)
+	{
+		for (const FVector2D& Point : Line.Points)
+			Bounds += Point;
+	}
+
+	const FSRAugmentTransform Transform(InSettings, InRandom);
+	const FVector2D Center = Bounds.bIsValid ? Bounds.GetCenter() : FVector2D::ZeroVector;
+	const FVector2D Extent = Bounds.bIsValid ? Bounds.GetSize() : FVector2D::ZeroVector;
+	const float Size = FMath::Max3(Extent.X, Extent.Y, KINDA_SMALL_NUMBER);
+
+	TArray<FSRDrawLine> Lines = InLines;
+	for (FSRDrawLine& Line : Lines)
+	{
+		for (FVector2D& Point : Line.Points)
+		{
+			const FVector2D UV = (Point - Center) / Size + FVector2D(0.5f, 0.5f);
+			Point = (Transform.Forward(UV) - FVector2D(0.5f, 0.5f)) * Size + Center;
+		}
+	}
+
+	return FSRStrokeEncoder::Encode(Lines, OutDescriptor);
+}
+
+////////////////////////////////////////////////////////////
+
+FSRAugmentationPipeline::~FSRAugmentationPipeline()
+{
+	//background work writes to Next.
+	if (Pending.IsValid())
+	{
+		Pending.Wait();
+	}
+}
+
+void FSRAugmentationPipeline::Init(const TArray<FSRTrainingDataSet>& InTrainingSets, const FSRAugmentationSettings& InSettings, int32 InSeed, FSRTrainingThreadPool& InPool)
+{
+	TrainingSets = InSettings.bEnabled ? &InTrainingSets : nullptr;
+	Pool = &InPool;
+	Settings = InSettings;
+	Seed = InSeed;
+}
+
+double FSRAugmentationPipeline::BeginEpoch(int32 InEpoch)
+{
+	if (!IsEnabled())
+	{
+		return 0.0;
+	}
+
+	if (PendingEpoch != InEpoch)
+	{
+		//nothing prepared for this epoch (first epoch or resumed training).
+		if (Pending.IsValid())
+		{
+			Pending.Wait();
+		}
+		StartEpoch(InEpoch);
+	}
+
+	const double WaitStartTime = FPlatformTime::Seconds();
+	Pending.Wait();
+	const double WaitSeconds = FPlatformTime::Seconds() - WaitStartTime;
+	Pending = TFuture<void>();
+
+	Swap(Current, Next);
+	StartEpoch(InEpoch + 1);
+	return WaitSeconds;
+}
+
+void FSRAugmentationPipeline::StartEpoch(int32 InEpoch)
+{
+	PendingEpoch = InEpoch;
+	//coordinator gets its own thread (see NetworkTrainingAsyncTask::StartEvaluation), its ParallelFor runs on the training pool.
+	Pending = Async(EAsyncExecution::Thread, [this, InEpoch]()
+	{
+		Generate(InEpoch, Next);
+	});
+}
+
+void FSRAugmentationPipeline::Generate(int32 InEpoch, TArray<TArray<TArray<float>>>& OutInputs) const
+{
+	TArray<TPair<int32, int32>> Samples;
+	OutInputs.SetNum(TrainingSets->Num());
+	for (int32 SetIdx = 0; SetIdx < TrainingSets->Num(); ++SetIdx)
+	{
+		const int32 InputsCount = (*TrainingSets)[SetIdx].Inputs.Num();
+		OutInputs[SetIdx].SetNum(InputsCount);
+		for (int32 InputIdx = 0; InputIdx < InputsCount; ++InputIdx)
+			Samples.Emplace(SetIdx, InputIdx);
+	}
+
+	Pool->ParallelFor(Samples.Num(), [&](int32 SampleIdx)
+	{
+		const FSRTrainingDataSet& TrainingSet = (*TrainingSets)[Samples[SampleIdx].Key];
+		const int32 InputIdx = Samples[SampleIdx].Value;
+		FRandomStream Random((int32)HashCombine(HashCombine(GetTypeHash(Seed), GetTypeHash(InEpoch)), GetTypeHash(SampleIdx)));
+		TArray<float>& Output = OutInputs[Samples[SampleIdx].Key][InputIdx];
+		if (!TrainingSet.Strokes.IsValidIndex(InputIdx))
+			FSRSampleAugmenter::AugmentPixels(TrainingSet.Inputs[InputIdx], Output, Settings, Random);
+		else if (!FSRSampleAugmenter::AugmentStrokes(TrainingSet.Strokes[InputIdx], Output, Settings, Random))
+			Output = TrainingSet.Inputs[InputIdx];
+	});
+}
@@ -14,6 +14,7 @@
 #include "SRCanvasHandler.h"
 #include "SRPluginEditorStyle.h"
 #include "SRToolWidget.h"
+#include "SRTrainingThreadPool.h"
 #include "Runtime/Slate/Public/Widgets/Layout/SBox.h"
 #include "Runtime/Slate/Public/Widgets/Layout/SScrollBox.h"
 
@@ -30,6 +31,8 @@ public:
 	int32 EpochsValue = 0;
 	float AccuracyValue = 0.0f;
 	TSharedPtr<STextBlock> EpochsText;
+	TSharedPtr<STextBlock> StatsText;
+	int32 StatsEpochsValue = -1;
 	TArray<TSharedPtr<STextBlock>> AccuracyTexts;
 	TSharedPtr<SScrollBox> ScoresScrollBox;
 
@@ -46,29 +49,34 @@ public:
 		return EVisibility::Collapsed;
 	}
 
+	void RebuildScoreTexts(int32 InSymbolsCount)
+	{
+		AccuracyTexts.Empty();
+		AccuracyValue = -1.0f;
+
+		if (ScoresScrollBox.IsValid())
+		{
+			ScoresScrollBox->ClearChildren();
+		}
+		for (int32 I = 0; I < InSymbolsCount + 1; ++I)
+		{
+			TSharedPtr<STextBlock> ScoreTextBlock;
+			ScoresScrollBox->AddSlot().Padding(2)
+			[
+				SAssignNew(ScoreTextBlock, STextBlock)
+			];
+
+			AccuracyTexts.Add(ScoreTextBlock);
+		}
+	}
+
 	void Construct(const FArguments& InArgs, class USRToolManager* InToolKit)
 	{
 		ToolKit = InToolKit;
 		ToolKit->OnStartedTraining.AddLambda([this]() {
 			AnimatedProgress = 0.0f;
-			AccuracyTexts.Empty();
-			AccuracyValue = -1.0f;
-
-			if (ScoresScrollBox.IsValid())
-			{
-				ScoresScrollBox->ClearChildren();
-			}
-			int32 SymbolsCount = ToolKit->GetCurrentProfileRef().SymbolsAmount;
-			for (int32 I = 0; I < SymbolsCount + 1; ++I)
-			{
-				TSharedPtr<STextBlock> ScoreTextBlock;
-				ScoresScrollBox->AddSlot().Padding(2)
-				[
-					SAssignNew(ScoreTextBlock, STextBlock)
-				];
-
-				AccuracyTexts.Add(ScoreTextBlock);
-			}
+			StatsEpochsValue = -1;
+			RebuildScoreTexts(ToolKit->GetCurrentProfileRef().SymbolsAmount);
 		});
 		Visibility.Bind(this, &SRTrainingInfoBox::EstimateVisibility);
 
@@ -92,6 +100,12 @@ public:
 						SAssignNew(EpochsText, STextBlock)
 					]
 					+ SVerticalBox::Slot()
+					.Padding(5)
+					.AutoHeight()
+					[
+						SAssignNew(StatsText, STextBlock)
+					]
+					+ SVerticalBox::Slot()
 					.MaxHeight(250.0f)
 					[
 						SAssignNew(ScoresScrollBox, SScrollBox)
@@ -193,11 +207,23 @@ public:
 					EpochsValue = ToolKit->GetSymbolTrainingEpochs();
 					EpochsText->SetText(FText::FromString("Epochs: " + FString::FromInt(EpochsValue)));
 				}
+
+				const FSRTrainingStats Stats = ToolKit->GetSymbolTrainingStats();
+				if (StatsEpochsValue != Stats.Epochs)
+				{
+					StatsEpochsValue = Stats.Epochs;
+					StatsText->SetText(GetStatsText(Stats));
+				}
 				
 				
 				float GlobalTrainingScore;
 				TArray<float> ScoresPerSymbol;
 				ToolKit->GetSymbolTrainingScores(ScoresPerSymbol, GlobalTrainingScore);
+				//selected profile may be switched to other running training.
+				if (ScoresPerSymbol.Num() > 0 && AccuracyTexts.Num() != ScoresPerSymbol.Num() + 1)
+				{
+					RebuildScoreTexts(ScoresPerSymbol.Num());
+				}
 
 				if (FMath::IsNearlyEqual(AccuracyValue, GlobalTrainingScore, 0.0001f) == false)
 				{
@@ -232,11 +258,88 @@ public:
 	{
 		return TOptional<float>(AnimatedProgress);
 	}
+
+	static FText GetStatsText(const FSRTrainingStats& InStats)
+	{
+		if (InStats.Epochs == 0)
+		{
+			return FText::FromString("Measuring speed...");
+		}
+
+		const FString EstimatedTime = InStats.EstimatedSecondsLeft >= 0.0 ? FTimespan::FromSeconds(InStats.EstimatedSecondsLeft).ToString(TEXT("%h:%m:%s")) : FString("unknown");
+		return FText::FromString(FString::Printf(TEXT("%.0f samples/s | epoch: %.2fs (wait for evaluation: %.2fs, augmentation: %.2fs) | per sample: %.1fus training, %.1fus forward on a worker\nevaluation: %.2fs | loss: %f | left: %s"),
+			InStats.SamplesPerSecond, InStats.EpochSeconds, InStats.EvaluationWaitSeconds, InStats.AugmentationWaitSeconds, InStats.TrainSecondsPerSample * 1000000.0, InStats.ForwardSecondsPerSample * 1000000.0,
+			InStats.EvaluationSeconds, InStats.Loss, *EstimatedTime));
+	}
 		
 };
 
 
 
+/*
+ * Status of every queued and running training, so trainings of not selected profiles are visible too.
+ */
+class SRTrainingJobsList : public SCompoundWidget
+{
+public:
+	SLATE_BEGIN_ARGS(SRTrainingJobsList) {}
+	SLATE_END_ARGS()
+
+	TWeakObjectPtr<USRToolManager> ToolKit;
+
+	EVisibility EstimateVisibility() const
+	{
+		return (ToolKit.IsValid() && ToolKit->GetTrainingScheduler().HasActiveJobs()) ? EVisibility::Visible : EVisibility::Collapsed;
+	}
+
+	void Construct(const FArguments& InArgs, class USRToolManager* InToolKit)
+	{
+		ToolKit = InToolKit;
+		Visibility.Bind(this, &SRTrainingJobsList::EstimateVisibility);
+
+		ChildSlot
+		[
+			SNew(SBorder)
+			.Padding(5)
+			[
+				SNew(STextBlock)
+				.Text(this, &SRTrainingJobsList::GetJobsText)
+			]
+		];
+	}
+
+	FText GetJobsText() const
+	{
+		if (!ToolKit.IsValid())
+		{
+			return FText::GetEmpty();
+		}
+
+		FString Result = "Trainings:";
+		for (const FSRTrainingJobRef& Job : ToolKit->GetTrainingScheduler().GetJobs())
+		{
+			float Progress;
+			int32 Epochs;
+			TArray<float> Scores;
+			Job->GetProgress(Progress, Epochs, Scores);
+
+			FString StateName;
+			switch (Job->GetState())
+			{
+			case ESRTrainingJobState::Queued: StateName = "Queued"; break;
+			case ESRTrainingJobState::Running: StateName = Job->IsStopRequested() ? "Stopping" : (FSRTrainingThreadPool::Get().IsPaused() ? "Paused" : "Running"); break;
+			case ESRTrainingJobState::Completed: StateName = "Saving"; break;
+			default: StateName = "Stopped"; break;
+			}
+
+			Result += FString::Printf(TEXT("\n%s | %s | epochs: %i | progress: %i%% | cores: %i"), *Job->GetDisplayName(), *StateName, Epochs,
+				FMath::RoundToInt(FMath::Min(Progress, 1.0f) * 100.0f), Job->GetCoresCost());
+		}
+
+		return FText::FromString(Result);
+	}
+};
+
 class SRDrawingCanvas : public SBorder
 {
 public:
@@ -366,6 +469,14 @@ void SRToolKitWindow::Construct(const FArguments& InArgs, class USRToolManager*
 					SNew(SRTrainingInfoBox, BaseTool.Get())
 				//]
 			]
+
+			+ SOverlay::Slot()
+			.HAlign(HAlign_Left)
+			.VAlign(VAlign_Top)
+			.Padding(5)
+			[
+				SNew(SRTrainingJobsList, BaseTool.Get())
+			]
 		];
 	CurrentSymbol = BaseTool->GetCurrentSymbol();
 	UpdateBackground(CurrentSymbol.BackgroundHelper.LoadSynchronous());
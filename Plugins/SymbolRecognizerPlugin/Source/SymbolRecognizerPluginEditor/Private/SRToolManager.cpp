@@ -25,9 +25,14 @@
 #include "Runtime/Slate/Public/Widgets/Input/SButton.h"
 #include "SymbolRecognizerPluginEditor.h"
 #include "SRPopupHandler.h"
+#include "SRStrokeEncoder.h"
+#include "SRTrainingCheckpoint.h"
+#include "Misc/Crc.h"
 
 const FString USRToolManager::SREditorIniPath = "Resources/SymbolRecognizerEditor.ini";
 const FString USRToolManager::SRSymbolsPath = "Resources/Symbols";
+//change when training gives different networks for the same images and params, so saved hashes don't match.
+static const uint32 SRTrainingHashVersion = 1;
 
 
 USRToolManager::USRToolManager(class FObjectInitializer const & ObjInit) : Super(ObjInit)
@@ -110,6 +115,7 @@ bool USRToolManager::DeleteImage(int32 InSymbolId, int32 InImageId)
 		FString ImgPath = GetCurrentProfileRef().Symbols[InSymbolId].Images[InImageId].Path;
 		if (FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*ImgPath))
 		{
+			GetSymbolRecognizer()->RemoveStrokeSample(InSymbolId, InImageId);
 			CallImageSelected(InSymbolId, InImageId);
 			return true;
 		}
@@ -535,6 +541,10 @@ bool USRToolManager::SaveImage(int32 InSymbolId, int32 InImageId)
 {
 	FSRImageDataItem& ImgData = GetCurrentProfileRef().Symbols[InSymbolId].Images[InImageId];
 	bool bSaveResult = GetNeuralHandler()->SaveRenderTargetToDisk(GetCurrentProfileRef().Symbols[InSymbolId].Path, ImgData.GetImageName());//take path from image or symbol?
+	if (bSaveResult)
+	{
+		GetSymbolRecognizer()->SaveStrokeSample(FSRStrokeSample(InSymbolId, InImageId, GetNeuralHandler()->GetDrawLinesRef()));
+	}
 	if (CheckImageFileExists(ImgData) == false)
 	{
 		ImgData.Path = GetCurrentProfileRef().Symbols[InSymbolId].Path + "/" + ImgData.GetImageName();
@@ -720,10 +730,103 @@ FString USRToolManager::GetDefaultProfilesDirectory() const
 
 int32 USRToolManager::GetInputNodesCount() const
 {
+	if (Profiles.IsValidIndex(CurrentProfileDataID) && Profiles[CurrentProfileDataID].InputEncoding == ESRInputEncoding::StrokeDirections)
+	{
+		return FSRStrokeEncoder::GetDescriptorSize();
+	}
+
 	return GetSymbolRecognizer()->GetSymbolTextureSize() * GetSymbolRecognizer()->GetSymbolTextureSize();
 }
 
-void USRToolManager::TrainNetwork()
+void USRToolManager::TrainNetwork(bool bAskToResume, bool bForce)
+{
+	if (GetCurrentProfileRef().RecognizerBackend == ESRRecognizerBackend::PointCloud)
+	{
+		BuildStrokeTemplates();
+		GetSymbolRecognizer()->SaveSRData();
+		return;
+	}
+
+	const FString ProfileName = GetCurrentProfileRef().GetProfileName();
+	const uint32 TrainingHash = ComputeTrainingHash(GetCurrentProfileRef(), ComputeImagesHash());
+	if (!bForce && TrainingHash == GetSymbolRecognizer()->GetTrainingHash() && Validate_NeuralNetworkFileMatchesProfileParams())
+	{
+		GLog->Log("Network is up to date with images and params, training skipped: " + ProfileName);
+		if (bAskToResume)
+		{
+			TWeakObjectPtr<USRToolManager> WeakThis(this);
+			FOnClicked OnTrainAgain = FOnClicked::CreateLambda([WeakThis, ProfileName]()
+			{
+				SRPopup::HidePopup();
+				if (WeakThis.IsValid() && WeakThis->GetCurrentProfileRef().GetProfileName() == ProfileName)
+				{
+					WeakThis->TrainNetwork(true, true);
+				}
+				return FReply::Handled();
+			});
+			FOnClicked OnCancel = FOnClicked::CreateLambda([]()
+			{
+				SRPopup::HidePopup();
+				return FReply::Handled();
+			});
+
+			SRPopup::ShowPopup(FText::FromString(FString::Printf(TEXT("Network of %s was already trained on the same images and params.\n Confirm to train it again."),
+				*ProfileName)), OnTrainAgain, OnCancel);
+		}
+		return;
+	}
+
+	FSRTrainingJobRef Job = MakeTrainingJob();
+	Job->TrainingHash = TrainingHash;
+	FSRTrainingCheckpoint Checkpoint;
+	if (FSRTrainingCheckpoint::Load(Job->ProfileName, Checkpoint))
+	{
+		if (Checkpoint.ParamsHash != Job->ParamsHash)
+		{
+			GLog->Log("Training checkpoint doesn't match profile params or images, training from the beginning: " + Job->ProfileName);
+		}
+		else if (bAskToResume)
+		{
+			TWeakObjectPtr<USRToolManager> WeakThis(this);
+			FOnClicked OnResume = FOnClicked::CreateLambda([WeakThis, Job, Checkpoint]()
+			{
+				SRPopup::HidePopup();
+				if (WeakThis.IsValid())
+				{
+					Job->ResumeFrom(Checkpoint);
+					WeakThis->EnqueueTrainingJob(Job);
+				}
+				return FReply::Handled();
+			});
+			FOnClicked OnStartOver = FOnClicked::CreateLambda([WeakThis, Job]()
+			{
+				SRPopup::HidePopup();
+				if (WeakThis.IsValid())
+				{
+					WeakThis->EnqueueTrainingJob(Job);
+				}
+				return FReply::Handled();
+			});
+
+			SRPopup::ShowPopup(FText::FromString(FString::Printf(TEXT("Unfinished training of %s was found (%i epochs).\n Confirm to resume it, Cancel to start over."),
+				*Job->ProfileName, Checkpoint.Epochs)), OnResume, OnStartOver);
+			return;
+		}
+		else
+		{
+			Job->ResumeFrom(Checkpoint);
+		}
+	}
+
+	EnqueueTrainingJob(Job);
+}
+
+FSRTrainingJobRef USRToolManager::MakeTrainingJob()
+{
+	return MakeTrainingJob(GetCurrentProfileRef(), CollectTrainingSets());
+}
+
+FSRTrainingSetsRef USRToolManager::CollectTrainingSets()
 {
 	TArray<FSRTrainingDataSet> TrainingSets;
 	const int32 TrainingSetsNumber = GetCurrentProfileRef().SymbolsAmount;
@@ -731,32 +834,322 @@ void USRToolManager::TrainNetwork()
 	for (int32 SymbolId = 0; SymbolId < TrainingSetsNumber; ++SymbolId)
 	{
 		TArray<TArray<float>> TrainingSet;
-		CollectDataForTrainingSet(TrainingSet, GetCurrentProfileRef().Symbols[SymbolId].GetImagesPaths());
+		TArray<TArray<FSRDrawLine>> Strokes;
+		CollectInputsForSymbol(TrainingSet, SymbolId, &Strokes);
 		TrainingSets.Emplace(FSRTrainingDataSet(TrainingSet, TrainingSetsNumber, SymbolId));
+		TrainingSets.Last().Strokes = MoveTemp(Strokes);
 		GLog->Log("TrainingSet Collected: " + GetCurrentProfileRef().Symbols[SymbolId].Path);
 	}
 
-	int32 TrainingImagesCount = 0;
-	for (int32 I = 0; I < TrainingSets.Num(); I++)
-		TrainingImagesCount += TrainingSets[I].Inputs.Num();
+	return MakeShared<const TArray<FSRTrainingDataSet>, ESPMode::ThreadSafe>(MoveTemp(TrainingSets));
+}
 
-	
-	GetSymbolRecognizer()->GetNeuralNetworkRef(false) = FSRNeuralNetwork(GetInputNodesCount(), GetCurrentProfileRef().HiddenNodes, GetCurrentProfileRef().SymbolsAmount, GetCurrentProfileRef().LearningRate);
-	GetSymbolRecognizer()->GetNeuralNetworkRef(false).bIsTrained = false;
+uint32 USRToolManager::ComputeImagesHash()
+{
+	const FSRProfileData& Profile = GetCurrentProfileRef();
+	const int32 InputNodesCount = GetInputNodesCount();
+	uint32 Hash = FCrc::MemCrc32(&SRTrainingHashVersion, sizeof(SRTrainingHashVersion));
+	Hash = FCrc::MemCrc32(&InputNodesCount, sizeof(InputNodesCount), Hash);
+
+	TArray<uint8> FileData;
+	for (int32 SymbolId = 0; SymbolId < Profile.SymbolsAmount && Profile.Symbols.IsValidIndex(SymbolId); ++SymbolId)
+	{
+		for (const FSRImageDataItem& Img : Profile.Symbols[SymbolId].Images)
+		{
+			int32 Size = 0;
+			if (Profile.InputEncoding == ESRInputEncoding::Pixels)
+			{
+				FileData.Reset();
+				FFileHelper::LoadFileToArray(FileData, *Img.Path, FILEREAD_Silent);
+				Size = FileData.Num();
+				Hash = FCrc::MemCrc32(FileData.GetData(), FileData.Num(), Hash);
+			}
+			else
+			{
+				FSRStrokeSample Sample;
+				if (GetSymbolRecognizer()->GetStrokeSample(SymbolId, Img.ImgId, Sample) && !Sample.bFromPixels)
+				{
+					Size = Sample.Points.Num();
+					Hash = FCrc::MemCrc32(Sample.Points.GetData(), Sample.Points.Num() * sizeof(FVector2D), Hash);
+					Hash = FCrc::MemCrc32(Sample.LineStarts.GetData(), Sample.LineStarts.Num() * sizeof(int32), Hash);
+				}
+			}
+			//sizes keep samples apart, e.g. moving bytes between two images changes the hash.
+			Hash = FCrc::MemCrc32(&Size, sizeof(Size), Hash);
+		}
+	}
+
+	return Hash;
+}
+
+uint32 USRToolManager::ComputeTrainingHash(const FSRProfileData& InProfile, uint32 InImagesHash) const
+{
+	uint32 Hash = InImagesHash;
+	//all "Params" properties, so new params are covered without changes here.
+	for (TFieldIterator<UProperty> It(FSRProfileData::StaticStruct()); It; ++It)
+	{
+		//speed and resuming only, they are also overridden by SRTrain commandlet.
+		if (It->GetMetaData(TEXT("Category")) != TEXT("Params") || It->GetFName() == GET_MEMBER_NAME_CHECKED(FSRProfileData, TrainingThreads)
+			|| It->GetFName() == GET_MEMBER_NAME_CHECKED(FSRProfileData, CheckpointInterval))
+		{
+			continue;
+		}
+
+		FString Value;
+		It->ExportTextItem(Value, It->ContainerPtrToValuePtr<void>(&InProfile), nullptr, nullptr, PPF_None);
+		Hash = FCrc::StrCrc32(*Value, Hash);
+	}
+
+	//trunk trained again by other profile makes output layer of this one useless.
+	const FSRSharedTrunk* Trunk = InProfile.SharedTrunk.IsNone() ? nullptr : GetSymbolRecognizer()->FindSharedTrunk(InProfile.SharedTrunk);
+	const uint32 TrunkRevision = Trunk ? Trunk->Revision : 0;
+	Hash = FCrc::MemCrc32(&TrunkRevision, sizeof(TrunkRevision), Hash);
+
+	//0 means unknown hash.
+	return Hash != 0 ? Hash : 1;
+}
+
+FSRTrainingJobRef USRToolManager::MakeTrainingJob(const FSRProfileData& InProfile, const FSRTrainingSetsRef& InTrainingSets)
+{
+	FSRTrainingJobRef Job = MakeShared<FSRTrainingJob, ESPMode::ThreadSafe>();
+	Job->ProfileName = InProfile.GetProfileName();
+	Job->TrainingSets = InTrainingSets;
+	Job->SymbolsCount = InProfile.SymbolsAmount;
+	for (const FSRTrainingDataSet& TrainingSet : *Job->TrainingSets)
+		Job->ImagesCount += TrainingSet.Inputs.Num();
+	Job->HiddenNodes = InProfile.HiddenNodes;
+	Job->EpochsLimit = InProfile.bAutoTraining ? 0 : InProfile.LearningCycles;//0 epchs means auto training until Accuracy is reached.
+	Job->AcceptableAccuracy = InProfile.AcceptableTrainingAccuracy;
+	Job->DeltaBestAnswers = InProfile.DeltaTwoBestOutcomes;
+	Job->bUseCascade = InProfile.bUseCascade;
+	Job->CascadeHiddenNodes = InProfile.CascadeHiddenNodes;
+	Job->PrunedHiddenRatio = InProfile.SharedTrunk.IsNone() ? InProfile.PrunedHiddenRatio : 0.0f;
+	Job->Parallelism = InProfile.TrainingParallelism;
+	Job->ThreadsCount = InProfile.TrainingThreads > 0 ? InProfile.TrainingThreads : FPlatformMisc::NumberOfCoresIncludingHyperthreads();
+	const int32 GradientThreads = FMath::Min(InProfile.TrainingBatchSize, (int32)NetworkTrainingAsyncTask::MaxGradientSlots);
+	if (InProfile.TrainingParallelism == ESRTrainingParallelism::DataParallel && Job->ThreadsCount > GradientThreads)
+	{
+		GLog->Log(FString::Printf(TEXT("DataParallel training of %s computes gradients on %i of its %i threads (TrainingBatchSize %i), consider fewer TrainingThreads or bigger batches."),
+			*Job->ProfileName, GradientThreads, Job->ThreadsCount, InProfile.TrainingBatchSize));
+	}
+	Job->BatchSize = InProfile.TrainingBatchSize;
+	Job->SamplingMode = InProfile.TrainingSampling;
+	Job->RandomSeed = InProfile.RandomSeed;
+	Job->EvaluationInterval = InProfile.EvaluationInterval;
+	Job->EvaluationSampleRatio = InProfile.EvaluationSampleRatio;
+	Job->CheckpointInterval = InProfile.CheckpointInterval;
+	Job->Augmentation = InProfile.Augmentation;
+
+	Job->Network = FSRNeuralNetwork(GetInputNodesCount(), InProfile.HiddenNodes, InProfile.SymbolsAmount, InProfile.LearningRate,
+		InProfile.HiddenActivation, InProfile.OutputActivation, InProfile.RandomSeed);
+	Job->Network.InputEncoding = InProfile.InputEncoding;
+	Job->Network.InitializeGroups(InProfile.SharedTrunk.IsNone() ? InProfile.OutputGroupSize : 0);
+	Job->Network.bIsTrained = false;
+
+	if (!InProfile.SharedTrunk.IsNone() && !InProfile.bRetrainSharedTrunk)
+	{
+		const FSRSharedTrunk* Trunk = GetSymbolRecognizer()->FindSharedTrunk(InProfile.SharedTrunk);
+		if (Trunk && Trunk->IsCompatibleWith(Job->Network))
+		{
+			Job->Network.wih = Trunk->wih;
+			Job->bTrainOutputLayerOnly = true;
+		}
+		else if (Trunk)
+		{
+			GLog->Log("Shared trunk params differ from profile params, trunk will be trained again: " + InProfile.SharedTrunk.ToString());
+		}
+	}
+
+	//everything that makes a checkpoint of this training useless when changed.
+	const FSRNeuralNetwork& Network = Job->Network;
+	uint32 ParamsHash = FCrc::MemCrc32(&Network.InputNodes, sizeof(Network.InputNodes));
+	for (uint32 Value : { Network.HiddenNodes, Network.OutputNodes, Network.GroupSize, (uint32)Network.HiddenActivation, (uint32)Network.OutputActivation,
+		(uint32)Network.InputEncoding, (uint32)Job->bTrainOutputLayerOnly, (uint32)Job->bUseCascade, Job->CascadeHiddenNodes, (uint32)Job->RandomSeed })
+	{
+		ParamsHash = FCrc::MemCrc32(&Value, sizeof(Value), ParamsHash);
+	}
+	ParamsHash = FCrc::MemCrc32(&Network.LearningRate, sizeof(Network.LearningRate), ParamsHash);
+	ParamsHash = FCrc::StrCrc32(*InProfile.SharedTrunk.ToString(), ParamsHash);
+	for (const FSRTrainingDataSet& TrainingSet : *Job->TrainingSets)
+	{
+		for (const TArray<float>& Input : TrainingSet.Inputs)
+			ParamsHash = FCrc::MemCrc32(Input.GetData(), Input.Num() * sizeof(float), ParamsHash);
+	}
+	Job->ParamsHash = ParamsHash;
+
+	return Job;
+}
+
+void USRToolManager::EnqueueTrainingJob(const FSRTrainingJobRef& InJob)
+{
+	InJob->OnComplete = FTrainingTaskCompleteDelegate::CreateUObject(this, &USRToolManager::OnTrainingComplete, InJob);
+	InJob->OnStop = FTrainingTaskStopDelegate::CreateUObject(this, &USRToolManager::OnTrainingStop, InJob);
+
+	FSRTrainingThreadPool& TrainingPool = FSRTrainingThreadPool::Get();
+	TrainingPool.SetPauseDuringPIE(bPauseTrainingDuringPIE);
+	if (!TrainingPool.Configure(TrainingPoolThreads, TrainingThreadPriority, (uint64)TrainingAffinityMask))
+	{
+		GLog->Log("Training pool is busy, its new thread settings are used when all trainings finish.");
+	}
+
+	GetSymbolRecognizer()->SetNetworkMailbox(InJob->ProfileName, InJob->Mailbox);
+	TrainingScheduler.CoresBudget = TrainingCoresBudget;
+	TrainingScheduler.Enqueue(InJob);
+
+	OnStartedTraining.Broadcast();
+}
+
+void USRToolManager::TrainAllProfiles()
+{
+	const int32 SelectedProfileIdx = CurrentProfileDataID;
+	for (int32 ProfileIdx = 0; ProfileIdx < Profiles.Num(); ++ProfileIdx)
+	{
+		if (TrainingScheduler.FindActiveJob(Profiles[ProfileIdx].GetProfileName()).IsValid())
+		{
+			continue;
+		}
+
+		SwitchProfileForTraining(ProfileIdx);
+		if (Validate_AllImagesDrawn())
+		{
+			TrainNetwork(false);
+		}
+		else
+		{
+			GLog->Log("Profile skipped, not all images are drawn: " + Profiles[ProfileIdx].GetProfileName());
+		}
+	}
+
+	SwitchProfileForTraining(SelectedProfileIdx);
+	OnStartedTraining.Broadcast();
+}
+
+TSharedPtr<FSRHyperparameterSweep> USRToolManager::StartSweep()
+{
+	const FSRProfileData& Profile = GetCurrentProfileRef();
+	if (Profile.RecognizerBackend != ESRRecognizerBackend::NeuralNetwork)
+	{
+		GLog->Log("Sweep needs NeuralNetwork backend, profile: " + Profile.GetProfileName());
+		return nullptr;
+	}
+
+	//changing HiddenNodes would make the trunk useless for other profiles.
+	if (!Profile.SharedTrunk.IsNone())
+	{
+		GLog->Log("Sweep can't change HiddenNodes of profile with SharedTrunk: " + Profile.GetProfileName());
+		return nullptr;
+	}
+
+	if (TrainingScheduler.FindActiveJob(Profile.GetProfileName()).IsValid())
+	{
+		GLog->Log("Sweep can't start while profile is being trained: " + Profile.GetProfileName());
+		return nullptr;
+	}
+
+	FSRHyperparameterSweepRef Sweep = MakeShared<FSRHyperparameterSweep>();
+	Sweep->ProfileName = Profile.GetProfileName();
+	if (!Sweep->BuildCandidates(SweepSettings))
+	{
+		GLog->Log("Sweep settings describe no configuration (HiddenNodes, LearningRates and LearningCycles need values).");
+		return nullptr;
+	}
+
+	//images are decoded and hashed once for all candidates.
+	const FSRTrainingSetsRef TrainingSets = CollectTrainingSets();
+	Sweep->ImagesHash = ComputeImagesHash();
+	for (FSRSweepCandidate& Candidate : Sweep->Candidates)
+	{
+		FSRProfileData CandidateProfile = Profile;
+		CandidateProfile.HiddenNodes = Candidate.HiddenNodes;
+		CandidateProfile.LearningRate = Candidate.LearningRate;
+		CandidateProfile.LearningCycles = Candidate.LearningCycles;
+		CandidateProfile.bAutoTraining = false;
+		//configurations run next to each other, one core each.
+		CandidateProfile.TrainingParallelism = ESRTrainingParallelism::SingleThread;
+		CandidateProfile.CheckpointInterval = 0;
+
+		FSRTrainingJobRef Job = MakeTrainingJob(CandidateProfile, TrainingSets);
+		Job->Label = Candidate.GetLabel();
+		Job->OnComplete = FTrainingTaskCompleteDelegate::CreateUObject(this, &USRToolManager::OnSweepJobFinished, Job);
+		Job->OnStop = FTrainingTaskStopDelegate::CreateUObject(this, &USRToolManager::OnSweepJobFinished, Job);
+		Candidate.Job = Job;
+	}
+
+	FSRTrainingThreadPool& TrainingPool = FSRTrainingThreadPool::Get();
+	TrainingPool.SetPauseDuringPIE(bPauseTrainingDuringPIE);
+	TrainingPool.Configure(TrainingPoolThreads, TrainingThreadPriority, (uint64)TrainingAffinityMask);
+	TrainingScheduler.CoresBudget = TrainingCoresBudget;
+	Sweeps.Add(Sweep);
+	for (const FSRSweepCandidate& Candidate : Sweep->Candidates)
+	{
+		TrainingScheduler.Enqueue(Candidate.Job.ToSharedRef());
+	}
+
+	GLog->Log(FString::Printf(TEXT("Sweep of profile %s started, configurations: %i"), *Sweep->ProfileName, Sweep->Candidates.Num()));
+	OnStartedTraining.Broadcast();
+	return Sweep;
+}
 
-	bIsTraining = true;
+void USRToolManager::OnSweepJobFinished(FSRTrainingJobRef InJob)
+{
+	TWeakObjectPtr<USRToolManager> WeakThis(this);
+	FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, InJob]()
+	{
+		if (WeakThis.IsValid())
+		{
+			WeakThis->FinishSweepJob(InJob);
+		}
+	}, TStatId(), NULL, ENamedThreads::GameThread);
+}
+
+void USRToolManager::FinishSweepJob(const FSRTrainingJobRef& InJob)
+{
+	TrainingScheduler.OnJobFinished(InJob);
+
+	const int32 SweepIdx = Sweeps.IndexOfByPredicate([&InJob](const FSRHyperparameterSweepRef& Sweep) { return Sweep->FindCandidate(InJob) != nullptr; });
+	if (SweepIdx == INDEX_NONE)
+	{
+		return;
+	}
 
-	int32 EpochValue = GetCurrentProfileRef().bAutoTraining ? 0 : GetCurrentProfileRef().LearningCycles;
+	FSRHyperparameterSweepRef Sweep = Sweeps[SweepIdx];
+	Sweep->OnJobFinished(InJob);
+	if (!Sweep->IsFinished())
+	{
+		return;
+	}
+
+	Sweeps.RemoveAt(SweepIdx);
+	Sweep->LogResults();
 
-	//START ASYNC TASK
-	 (new FAutoDeleteAsyncTask<NetworkTrainingAsyncTask>(GetSymbolRecognizer()->GetNeuralNetworkRef(false), TrainingSets, GetCurrentProfileRef().SymbolsAmount, TrainingImagesCount,
-		GetInputNodesCount(), GetCurrentProfileRef().HiddenNodes, GetCurrentProfileRef().LearningRate, EpochValue, //0 epchs means auto training until Accuracy is reached.
-		 GetCurrentProfileRef().AcceptableTrainingAccuracy, GetCurrentProfileRef().DeltaTwoBestOutcomes,
-		FTrainingTaskCompleteDelegate::CreateUObject(this, &USRToolManager::OnTrainingComplete),
-		 FTrainingTaskStopDelegate::CreateUObject(this, &USRToolManager::OnTrainingStop)))->StartBackgroundTask();
+	const FSRSweepCandidate* Best = Sweep->GetBestCandidate();
+	FSRProfileData* Profile = Profiles.FindByPredicate([&Sweep](const FSRProfileData& Item) { return Item.GetProfileName() == Sweep->ProfileName; });
+	if (Best == nullptr || Profile == nullptr)
+	{
+		GLog->Log("Sweep found no configuration reaching AcceptableTrainingAccuracy, profile not changed: " + Sweep->ProfileName);
+		return;
+	}
 
-	 OnStartedTraining.Broadcast();
+	//profile params must match the saved network.
+	Profile->HiddenNodes = Best->HiddenNodes;
+	Profile->LearningRate = Best->LearningRate;
+	Profile->LearningCycles = Best->LearningCycles;
+	Profile->bAutoTraining = false;
+	GLog->Log("Sweep picked configuration: " + Best->GetLabel());
+
+	//saved network stands for the profile's params now (candidates were forced to single thread, no checkpoints).
+	Best->Job->TrainingHash = ComputeTrainingHash(*Profile, Sweep->ImagesHash);
+	//every candidate was already removed from scheduler above.
+	SaveTrainingJobResult(Best->Job.ToSharedRef());
+}
 
+void USRToolManager::SwitchProfileForTraining(int32 InProfileIdx)
+{
+	if (CurrentProfileDataID != InProfileIdx && Profiles.IsValidIndex(InProfileIdx))
+	{
+		CurrentProfileDataID = InProfileIdx;
+		GetSymbolRecognizer()->SelectProfile(GetCurrentProfileRef().GetProfileName(), true, false);
+	}
 }
 
 void USRToolManager::CollectDataForTrainingSet(TArray<TArray<float>>& OutData, const TArray<FString>& ImagesPaths)
@@ -773,6 +1166,39 @@ void USRToolManager::CollectDataForTrainingSet(TArray<TArray<float>>& OutData, c
 	}
 }
 
+void USRToolManager::CollectInputsForSymbol(TArray<TArray<float>>& OutData, int32 InSymbolId, TArray<TArray<FSRDrawLine>>* OutStrokes)
+{
+	const FSRSymbolDataItem& Symbol = GetCurrentProfileRef().Symbols[InSymbolId];
+	if (GetCurrentProfileRef().InputEncoding == ESRInputEncoding::Pixels)
+	{
+		CollectDataForTrainingSet(OutData, Symbol.GetImagesPaths());
+		return;
+	}
+
+	OutData.Empty();
+	if (OutStrokes)
+	{
+		OutStrokes->Reset();
+	}
+	TArray<FSRDrawLine> Lines;
+	for (const FSRImageDataItem& Img : Symbol.Images)
+	{
+		FSRStrokeSample Sample;
+		if (!GetSymbolRecognizer()->GetStrokeSample(InSymbolId, Img.ImgId, Sample) || Sample.bFromPixels)
+		{
+			GLog->Log("No strokes saved for image (draw and save it again): " + Img.Path);
+			continue;
+		}
+
+		Sample.ToDrawLines(Lines);
+		FSRStrokeEncoder::Encode(Lines, OutData.AddDefaulted_GetRef());
+		if (OutStrokes)
+		{
+			OutStrokes->Add(Lines);
+		}
+	}
+}
+
 bool USRToolManager::LoadTrainDataFromTexture(FString InFilePath, TArray<float>& OutData, bool bAppendPNG /*= true*/)
 {
 	TArray<uint8> RawFileData;
@@ -802,62 +1228,277 @@ bool USRToolManager::LoadTrainDataFromTexture(FString InFilePath, TArray<float>&
 	return OutData.Num() > 0;
 }
 
-void USRToolManager::OnTrainingComplete()
+void USRToolManager::BuildQuantizedNetwork(const FSRTrainingJob& InJob)
+{
+	TArray<TArray<float>> CalibrationInputs;
+	InJob.CollectCalibrationInputs(CalibrationInputs);
+
+	const float AgreementRate = GetSymbolRecognizer()->BuildQuantizedNetwork(CalibrationInputs);
+	if (AgreementRate < 0.0f)
+	{
+		GLog->Log("Quantized network could not be built for profile: " + GetCurrentProfileRef().GetProfileName());
+	}
+	else
+	{
+		GLog->Log("Quantized network agreement with float network: " + FString::SanitizeFloat(AgreementRate * 100.0f) + "%");
+	}
+}
+
+void USRToolManager::SavePrunedNetwork(const FSRTrainingJob& InJob)
+{
+	GetSymbolRecognizer()->SavePrunedNetwork(InJob.PrunedNetwork, InJob.PrunedAgreementRate);
+	const float AgreementRate = InJob.PrunedAgreementRate;
+	if (AgreementRate < 0.0f)
+	{
+		GLog->Log("Pruned network could not be built for profile: " + GetCurrentProfileRef().GetProfileName());
+	}
+	else
+	{
+		GLog->Log("Pruned network agreement with full network: " + FString::SanitizeFloat(AgreementRate * 100.0f) + "%");
+	}
+}
+
+void USRToolManager::BuildStrokeTemplates()
+{
+	USymbolRecognizer* SR = GetSymbolRecognizer();
+	const FSRProfileData& Profile = GetCurrentProfileRef();
+	SR->RemoveStrokeSamplesOutOfRange(Profile.SymbolsAmount, Profile.ImagesPerSymbol);
+
+	int32 PixelSamples = 0;
+	for (int32 SymbolId = 0; SymbolId < Profile.SymbolsAmount; ++SymbolId)
+	{
+		for (const FSRImageDataItem& Img : Profile.Symbols[SymbolId].Images)
+		{
+			if (SR->HasStrokeSample(SymbolId, Img.ImgId) || !CheckImageFileExists(Img))
+			{
+				continue;
+			}
+
+			TArray<float> ImageData;
+			if (LoadTrainDataFromTexture(Img.Path, ImageData, false))
+			{
+				SR->SaveStrokeSample(FSRStrokeSample::FromPixels(SymbolId, Img.ImgId, ImageData));
+				PixelSamples++;
+			}
+		}
+	}
+
+	SR->SaveProfileBackend(Profile.RecognizerBackend, Profile.bPointCloudRotationInvariant);
+	GLog->Log(FString::Printf(TEXT("Point cloud templates ready for profile: %s (%i converted from pixels)"), *Profile.GetProfileName(), PixelSamples));
+}
+
+void USRToolManager::OnTrainingComplete(FSRTrainingJobRef InJob)
+{
+	GLog->Log("OnTrainingComplete: " + InJob->ProfileName);
+
+	TWeakObjectPtr<USRToolManager> WeakThis(this);
+	FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, InJob]()
+	{
+		if (WeakThis.IsValid())
+		{
+			WeakThis->FinishTrainingJob(InJob);
+		}
+	}, TStatId(), NULL, ENamedThreads::GameThread);
+}
+
+void USRToolManager::FinishTrainingJob(const FSRTrainingJobRef& InJob)
+{
+	SaveTrainingJobResult(InJob);
+	TrainingScheduler.OnJobFinished(InJob);
+}
+
+void USRToolManager::SaveTrainingJobResult(const FSRTrainingJobRef& InJob)
+{
+	//saved network replaces the preview.
+	GetSymbolRecognizer()->SetNetworkMailbox(InJob->ProfileName, nullptr);
+
+	const int32 SelectedProfileIdx = CurrentProfileDataID;
+	const int32 JobProfileIdx = Profiles.IndexOfByPredicate([&InJob](const FSRProfileData& Profile) { return Profile.GetProfileName() == InJob->ProfileName; });
+	if (JobProfileIdx == INDEX_NONE)
+	{
+		GLog->Log("Training result dropped, profile doesn't exist anymore: " + InJob->ProfileName);
+		return;
+	}
+
+	//saving routines work on selected profile.
+	SwitchProfileForTraining(JobProfileIdx);
+	GetSymbolRecognizer()->GetNeuralNetworkRef(false) = InJob->Network;
+	GetSymbolRecognizer()->GetCascadeNetworkRef() = InJob->CascadeNetwork;
+
+	FSRProfileData& Profile = GetCurrentProfileRef();
+	//network stopped early doesn't count as trained on these params.
+	uint32 TrainingHash = InJob->GetState() == ESRTrainingJobState::Completed ? InJob->TrainingHash : 0;
+	if (!Profile.SharedTrunk.IsNone())
+	{
+		FSRNeuralNetwork& Network = GetSymbolRecognizer()->GetNeuralNetworkRef(false);
+		if (InJob->bTrainOutputLayerOnly)
+		{
+			const FSRSharedTrunk* Trunk = GetSymbolRecognizer()->FindSharedTrunk(Profile.SharedTrunk);
+			Network.SharedTrunk = Profile.SharedTrunk;
+			Network.SharedTrunkRevision = Trunk ? Trunk->Revision : 0;
+		}
+		else
+		{
+			GetSymbolRecognizer()->SaveSharedTrunk(Profile.SharedTrunk, Network);
+			Profile.bRetrainSharedTrunk = false;
+			//hash was computed with the previous trunk revision.
+			TrainingHash = 0;
+			GLog->Log("Shared trunk trained, other profiles using it must be trained again: " + Profile.SharedTrunk.ToString());
+		}
+		GetSymbolRecognizer()->ClearQuantizedNetwork();
+		GetSymbolRecognizer()->ClearPrunedNetwork();
+	}
+	else
+	{
+		if (Profile.bBuildQuantizedNetwork)
+		{
+			BuildQuantizedNetwork(*InJob);
+		}
+		else
+		{
+			GetSymbolRecognizer()->ClearQuantizedNetwork();
+		}
+
+		if (InJob->PrunedHiddenRatio > 0.0f)
+		{
+			SavePrunedNetwork(*InJob);
+		}
+		else
+		{
+			GetSymbolRecognizer()->ClearPrunedNetwork();
+		}
+	}
+	GetSymbolRecognizer()->SaveCascadeNetwork(InJob->bUseCascade, Profile.CascadeExitMargin);
+	GetSymbolRecognizer()->SaveTrainingHash(TrainingHash);
+	GetSymbolRecognizer()->SaveNeuralProfile(Profile.GetProfileName());
+	FSRTrainingCheckpoint::Delete(Profile.GetProfileName());
+
+	SwitchProfileForTraining(SelectedProfileIdx);
+}
+
+void USRToolManager::OnTrainingStop(FSRTrainingJobRef InJob)
 {
-	bIsTraining = false;
-	GLog->Log("OnTrainingComplete");
+	GLog->Log("OnTrainingStop: " + InJob->ProfileName);
 
-	FFunctionGraphTask::CreateAndDispatchWhenReady([this]()
+	if (InJob->ShouldSaveOnStop())
 	{
-		GetSymbolRecognizer()->SaveNeuralProfile(GetCurrentProfileRef().GetProfileName());
+		OnTrainingComplete(InJob);
+		return;
+	}
+
+	TWeakObjectPtr<USRToolManager> WeakThis(this);
+	FFunctionGraphTask::CreateAndDispatchWhenReady([WeakThis, InJob]()
+	{
+		if (WeakThis.IsValid())
+		{
+			WeakThis->GetSymbolRecognizer()->SetNetworkMailbox(InJob->ProfileName, nullptr);
+			WeakThis->TrainingScheduler.OnJobFinished(InJob);
+		}
 	}, TStatId(), NULL, ENamedThreads::GameThread);
+}
 
+bool USRToolManager::GetIsTraningNetwork() const
+{
+	return GetCurrentTrainingJob().IsValid();
 }
 
-void USRToolManager::OnTrainingStop()
+TSharedPtr<FSRTrainingJob, ESPMode::ThreadSafe> USRToolManager::GetCurrentTrainingJob() const
 {
-	NetworkTrainingAsyncTask::bShouldStopSymbolTraining = false;
-	bIsTraining = false;
-	GLog->Log("OnTrainingStop");
+	return Profiles.IsValidIndex(CurrentProfileDataID) ? TrainingScheduler.FindActiveJob(Profiles[CurrentProfileDataID].GetProfileName()) : nullptr;
 }
 
 void USRToolManager::CancelTrainingTask(bool bShouldSaveResult)
 {
-	if (bIsTraining)
-	{
-		NetworkTrainingAsyncTask::bShouldStopSymbolTraining = true;
-		if (bShouldSaveResult)
+	const FString ProfileName = Profiles.IsValidIndex(CurrentProfileDataID) ? Profiles[CurrentProfileDataID].GetProfileName() : FString();
+	const int32 SweepIdx = Sweeps.IndexOfByPredicate([&ProfileName](const FSRHyperparameterSweepRef& Sweep) { return Sweep->ProfileName == ProfileName; });
+	if (SweepIdx != INDEX_NONE)
+	{
+		//removed first, so candidates finishing after stop only leave the scheduler (see FinishSweepJob).
+		FSRHyperparameterSweepRef Sweep = Sweeps[SweepIdx];
+		Sweeps.RemoveAt(SweepIdx);
+		//queued candidates go first, so removing them can't start another candidate.
+		for (int32 Idx = Sweep->Candidates.Num() - 1; Idx >= 0; --Idx)
 		{
-			OnTrainingComplete();
+			const FSRSweepCandidate& Candidate = Sweep->Candidates[Idx];
+			if (Candidate.Job.IsValid() && Candidate.Job->IsActive())
+			{
+				TrainingScheduler.Stop(Candidate.Job.ToSharedRef(), false);
+			}
 		}
+
+		GLog->Log("Sweep cancelled, profile not changed: " + ProfileName);
+		return;
+	}
+
+	TSharedPtr<FSRTrainingJob, ESPMode::ThreadSafe> Job = GetCurrentTrainingJob();
+	if (Job.IsValid())
+	{
+		TrainingScheduler.Stop(Job.ToSharedRef(), bShouldSaveResult);
 	}
 }
 
+void USRToolManager::StopTrainingJob(const FSRTrainingJobRef& InJob, bool bShouldSaveResult)
+{
+	TrainingScheduler.Stop(InJob, bShouldSaveResult);
+}
+
 float USRToolManager::GetSymbolTrainingProgress() const
 {
-	return NetworkTrainingAsyncTask::Progress;
+	float Progress = 0.0f;
+	int32 Epochs;
+	TArray<float> Scores;
+	if (TSharedPtr<FSRTrainingJob, ESPMode::ThreadSafe> Job = GetCurrentTrainingJob())
+	{
+		Job->GetProgress(Progress, Epochs, Scores);
+	}
+
+	return Progress;
 }
 
 int32 USRToolManager::GetSymbolTrainingEpochs() const
 {
-	return NetworkTrainingAsyncTask::CurrentEpochs;
+	float Progress;
+	int32 Epochs = 0;
+	TArray<float> Scores;
+	if (TSharedPtr<FSRTrainingJob, ESPMode::ThreadSafe> Job = GetCurrentTrainingJob())
+	{
+		Job->GetProgress(Progress, Epochs, Scores);
+	}
+
+	return Epochs;
 }
 
 void USRToolManager::GetSymbolTrainingScores(TArray<float>& OutScoresPerSymbol, float& OutGlobalScore) const
 {
 	OutGlobalScore = 0.0f;
-	OutScoresPerSymbol = NetworkTrainingAsyncTask::SymbolsScores;
+	OutScoresPerSymbol.Reset();
+	float Progress;
+	int32 Epochs;
+	if (TSharedPtr<FSRTrainingJob, ESPMode::ThreadSafe> Job = GetCurrentTrainingJob())
+	{
+		Job->GetProgress(Progress, Epochs, OutScoresPerSymbol);
+	}
+
 	float SumScores = 0;
 	for (float ScoreValue : OutScoresPerSymbol)
 	{
 		SumScores += ScoreValue;
 	}
-	OutGlobalScore = SumScores / OutScoresPerSymbol.Num();
+	OutGlobalScore = OutScoresPerSymbol.Num() > 0 ? SumScores / OutScoresPerSymbol.Num() : 0.0f;
+}
+
+FSRTrainingStats USRToolManager::GetSymbolTrainingStats() const
+{
+	TSharedPtr<FSRTrainingJob, ESPMode::ThreadSafe> Job = GetCurrentTrainingJob();
+	return Job.IsValid() ? Job->GetStats() : FSRTrainingStats();
 }
 
 void USRToolManager::SetShouldStopTraining(bool InValue)
 {
-	NetworkTrainingAsyncTask::bShouldStopSymbolTraining = InValue;
+	if (InValue)
+	{
+		TrainingScheduler.StopAll(false);
+	}
 }
 
 void USRToolManager::SRSaveConfig()
@@ -967,6 +1608,12 @@ bool USRToolManager::Validate_AllImagesDrawn()
 
 bool USRToolManager::Validate_NeuralNetworkFileMatchesProfileParams()
 {
+	if (GetCurrentProfileRef().RecognizerBackend == ESRRecognizerBackend::PointCloud)
+	{
+		GetSymbolRecognizer()->GetNeuralNetworkRef(true);
+		return GetSymbolRecognizer()->IsBackendReady(ESRRecognizerBackend::PointCloud);
+	}
+
 	FSRNeuralNetwork& NeuralData = GetSymbolRecognizer()->GetNeuralNetworkRef(true);
 
 	if (!NeuralData.bIsTrained)
@@ -989,6 +1636,22 @@ bool USRToolManager::Validate_NeuralNetworkFileMatchesProfileParams()
 		return false;
 	}
 
+	const uint32 ExpectedGroupSize = (GetCurrentProfileRef().SharedTrunk.IsNone() && GetCurrentProfileRef().OutputGroupSize < GetCurrentProfileRef().SymbolsAmount) ? GetCurrentProfileRef().OutputGroupSize : 0;
+	if (NeuralData.InputEncoding != GetCurrentProfileRef().InputEncoding || NeuralData.GroupSize != ExpectedGroupSize)
+	{
+		return false;
+	}
+
+	if (NeuralData.HiddenActivation != GetCurrentProfileRef().HiddenActivation || NeuralData.OutputActivation != GetCurrentProfileRef().OutputActivation)
+	{
+		return false;
+	}
+
+	if (NeuralData.SharedTrunk != GetCurrentProfileRef().SharedTrunk)
+	{
+		return false;
+	}
+
 	
 	return true;
 }
@@ -999,6 +1662,12 @@ void USRToolManager::PostEditChangeProperty(struct FPropertyChangedEvent& Proper
 {
 	Super::PostEditChangeProperty(PropertyChangedEvent);
 
+	if (PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(FSRProfileData, RecognizerBackend)
+		|| PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(FSRProfileData, bPointCloudRotationInvariant))
+	{
+		BuildStrokeTemplates();
+	}
+
 	/*if (PropertyChangedEvent.GetPropertyName() == TEXT("bTest"))
 	{	
 		CreateProfileAsset();	
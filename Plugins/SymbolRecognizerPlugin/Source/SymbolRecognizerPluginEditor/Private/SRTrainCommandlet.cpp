@@ -0,0 +1,224 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#include "SRTrainCommandlet.h"
+#include "SRToolManager.h"
+#include "SRTrainingJob.h"
+#include "SRTrainingCheckpoint.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Misc/Parse.h"
+#include "UObject/Package.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogSRTrain, Log, All);
+
+USRTrainCommandlet::USRTrainCommandlet(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+
+	HelpDescription = TEXT("Trains Symbol Recognizer profiles and saves their networks.");
+	HelpUsage = TEXT("<Project> -run=SRTrain [-profile=Name] [-threads=N] [-noresume] [-force] [-sweep] [-maxepochs=N] [-timeout=Seconds] -nullrhi");
+	HelpParamNames.Add(TEXT("profile"));
+	HelpParamDescriptions.Add(TEXT("Profile to train, all profiles are trained when not set."));
+	HelpParamNames.Add(TEXT("threads"));
+	HelpParamDescriptions.Add(TEXT("Threads of the training pool, also used as cores budget of concurrent trainings (0 = all cores but one)."));
+	HelpParamNames.Add(TEXT("noresume"));
+	HelpParamDescriptions.Add(TEXT("Ignore training checkpoints and train from the beginning."));
+	HelpParamNames.Add(TEXT("force"));
+	HelpParamDescriptions.Add(TEXT("Train profiles whose saved networks were trained on the same images and params too."));
+	HelpParamNames.Add(TEXT("maxepochs"));
+	HelpParamDescriptions.Add(FString::Printf(TEXT("Stop auto training that didn't reach AcceptableTrainingAccuracy after this many epochs (default %i, 0 = no limit)."), DefaultMaxEpochs));
+	HelpParamNames.Add(TEXT("timeout"));
+	HelpParamDescriptions.Add(FString::Printf(TEXT("Stop all trainings after this many seconds (default %.0f, 0 = no limit)."), DefaultTimeoutSeconds));
+	HelpParamNames.Add(TEXT("sweep"));
+	HelpParamDescriptions.Add(TEXT("Try SweepSettings configurations and save the cheapest network reaching AcceptableTrainingAccuracy (its params are saved to the profile)."));
+}
+
+int32 USRTrainCommandlet::Main(const FString& Params)
+{
+	FString ProfileName;
+	FParse::Value(*Params, TEXT("profile="), ProfileName);
+	int32 ThreadsCount = 0;
+	FParse::Value(*Params, TEXT("threads="), ThreadsCount);
+	const bool bResume = !FParse::Param(*Params, TEXT("noresume"));
+	const bool bForce = FParse::Param(*Params, TEXT("force"));
+	const bool bSweep = FParse::Param(*Params, TEXT("sweep"));
+	int32 MaxEpochs = DefaultMaxEpochs;
+	FParse::Value(*Params, TEXT("maxepochs="), MaxEpochs);
+	double TimeoutSeconds = DefaultTimeoutSeconds;
+	FParse::Value(*Params, TEXT("timeout="), TimeoutSeconds);
+
+	USRToolManager* ToolManager = NewObject<USRToolManager>(GetTransientPackage(), NAME_None, RF_Transient);
+	ToolManager->AddToRoot();
+	ToolManager->InitializeParams();
+
+	//overrides live only in this process, they are reverted before config is saved.
+	const bool bPauseTrainingDuringPIE = ToolManager->bPauseTrainingDuringPIE;
+	const int32 TrainingPoolThreads = ToolManager->TrainingPoolThreads;
+	const int32 TrainingCoresBudget = ToolManager->TrainingCoresBudget;
+	TArray<int32> TrainingThreads;
+	for (const FSRProfileData& Profile : ToolManager->Profiles)
+	{
+		TrainingThreads.Add(Profile.TrainingThreads);
+	}
+
+	ToolManager->bPauseTrainingDuringPIE = false;
+	if (ThreadsCount > 0)
+	{
+		ToolManager->TrainingPoolThreads = ThreadsCount;
+		ToolManager->TrainingCoresBudget = ThreadsCount;
+		for (FSRProfileData& Profile : ToolManager->Profiles)
+		{
+			Profile.TrainingThreads = ThreadsCount;
+		}
+	}
+
+	bool bSuccess = true;
+	int32 ProfilesCount = 0;
+	TArray<FSRHyperparameterSweepRef> Sweeps;
+	for (int32 ProfileIdx = 0; ProfileIdx < ToolManager->Profiles.Num(); ++ProfileIdx)
+	{
+		const FString CurrentName = ToolManager->Profiles[ProfileIdx].GetProfileName();
+		if (!ProfileName.IsEmpty() && !CurrentName.Equals(ProfileName, ESearchCase::IgnoreCase))
+		{
+			continue;
+		}
+
+		ProfilesCount++;
+		ToolManager->CallProfileSelected(ProfileIdx);
+		if (!ToolManager->Validate_AllImagesDrawn())
+		{
+			UE_LOG(LogSRTrain, Error, TEXT("Profile %s skipped, not all images are drawn."), *CurrentName);
+			bSuccess = false;
+			continue;
+		}
+
+		if (bSweep)
+		{
+			UE_LOG(LogSRTrain, Display, TEXT("Sweeping params of profile: %s"), *CurrentName);
+			TSharedPtr<FSRHyperparameterSweep> Sweep = ToolManager->StartSweep();
+			if (Sweep.IsValid())
+			{
+				Sweeps.Add(Sweep.ToSharedRef());
+			}
+			else
+			{
+				UE_LOG(LogSRTrain, Error, TEXT("Sweep of profile %s couldn't start."), *CurrentName);
+				bSuccess = false;
+			}
+			continue;
+		}
+
+		if (!bResume)
+		{
+			FSRTrainingCheckpoint::Delete(CurrentName);
+		}
+
+		UE_LOG(LogSRTrain, Display, TEXT("Training profile: %s"), *CurrentName);
+		ToolManager->TrainNetwork(false, bForce);
+	}
+
+	if (ProfilesCount == 0)
+	{
+		UE_LOG(LogSRTrain, Error, TEXT("No profile to train found (-profile=%s)."), *ProfileName);
+		ToolManager->RemoveFromRoot();
+		return 1;
+	}
+
+	//jobs are removed from scheduler once their results are saved.
+	const TArray<FSRTrainingJobRef> Jobs = ToolManager->GetTrainingScheduler().GetJobs();
+	const double StartTime = FPlatformTime::Seconds();
+	double LastLogTime = StartTime;
+	bool bTimedOut = false;
+	while (ToolManager->GetTrainingScheduler().HasActiveJobs())
+	{
+		//results are saved by tasks dispatched to the game thread.
+		FTaskGraphInterface::Get().ProcessThreadUntilIdle(ENamedThreads::GameThread);
+		FPlatformProcess::Sleep(0.1f);
+
+		//auto training runs until it reaches its accuracy, which may never happen.
+		for (const FSRTrainingJobRef& Job : Jobs)
+		{
+			if (MaxEpochs > 0 && Job->EpochsLimit <= 0 && Job->IsActive() && !Job->IsStopRequested() && Job->GetStats().Epochs >= MaxEpochs)
+			{
+				UE_LOG(LogSRTrain, Error, TEXT("%s didn't reach AcceptableTrainingAccuracy in %i epochs (-maxepochs), stopping it."), *Job->GetDisplayName(), MaxEpochs);
+				ToolManager->StopTrainingJob(Job);
+			}
+		}
+
+		if (!bTimedOut && TimeoutSeconds > 0.0 && FPlatformTime::Seconds() - StartTime >= TimeoutSeconds)
+		{
+			UE_LOG(LogSRTrain, Error, TEXT("Trainings didn't finish in %.0f seconds (-timeout), stopping them."), TimeoutSeconds);
+			bTimedOut = true;
+			ToolManager->SetShouldStopTraining(true);
+		}
+
+		if (FPlatformTime::Seconds() - LastLogTime >= ProgressLogInterval)
+		{
+			LastLogTime = FPlatformTime::Seconds();
+			for (const FSRTrainingJobRef& Job : Jobs)
+			{
+				const FSRTrainingStats Stats = Job->GetStats();
+				UE_LOG(LogSRTrain, Display, TEXT("%s | epochs: %i | accuracy: %f | %.0f samples/s"), *Job->GetDisplayName(), Stats.Epochs, Stats.Accuracy, Stats.SamplesPerSecond);
+			}
+		}
+	}
+	FTaskGraphInterface::Get().ProcessThreadUntilIdle(ENamedThreads::GameThread);
+
+	for (const FSRHyperparameterSweepRef& Sweep : Sweeps)
+	{
+		//queued candidates stopped by -timeout never finish, nothing was saved.
+		if (!Sweep->IsFinished())
+		{
+			UE_LOG(LogSRTrain, Error, TEXT("Sweep of profile %s was stopped before all configurations finished."), *Sweep->ProfileName);
+			bSuccess = false;
+		}
+		else if (const FSRSweepCandidate* Best = Sweep->GetBestCandidate())
+		{
+			UE_LOG(LogSRTrain, Display, TEXT("Profile %s trained with sweep, picked: %s | accuracy: %f | inference FLOPs: %lld"), *Sweep->ProfileName,
+				*Best->GetLabel(), Best->Accuracy, Best->InferenceFlops);
+		}
+		else
+		{
+			UE_LOG(LogSRTrain, Error, TEXT("No sweep configuration of profile %s reached AcceptableTrainingAccuracy."), *Sweep->ProfileName);
+			bSuccess = false;
+		}
+	}
+
+	//candidates failing the accuracy are expected in a sweep.
+	for (const FSRTrainingJobRef& Job : bSweep ? TArray<FSRTrainingJobRef>() : Jobs)
+	{
+		const FSRTrainingStats Stats = Job->GetStats();
+		if (Job->GetState() != ESRTrainingJobState::Completed)
+		{
+			UE_LOG(LogSRTrain, Error, TEXT("Training of %s was stopped."), *Job->ProfileName);
+			bSuccess = false;
+		}
+		else if (Stats.Accuracy < Job->AcceptableAccuracy)
+		{
+			UE_LOG(LogSRTrain, Error, TEXT("Profile %s trained with accuracy %f, AcceptableTrainingAccuracy is %f."), *Job->ProfileName, Stats.Accuracy, Job->AcceptableAccuracy);
+			bSuccess = false;
+		}
+		else
+		{
+			UE_LOG(LogSRTrain, Display, TEXT("Profile %s trained, epochs: %i accuracy: %f weights CRC: %08X"), *Job->ProfileName, Stats.Epochs, Stats.Accuracy, Stats.WeightsCrc);
+		}
+	}
+
+	//sweep changes profiles params.
+	if (bSweep)
+	{
+		ToolManager->bPauseTrainingDuringPIE = bPauseTrainingDuringPIE;
+		ToolManager->TrainingPoolThreads = TrainingPoolThreads;
+		ToolManager->TrainingCoresBudget = TrainingCoresBudget;
+		for (int32 ProfileIdx = 0; ProfileIdx < TrainingThreads.Num() && ProfileIdx < ToolManager->Profiles.Num(); ++ProfileIdx)
+		{
+			ToolManager->Profiles[ProfileIdx].TrainingThreads = TrainingThreads[ProfileIdx];
+		}
+		ToolManager->SRSaveConfig();
+	}
+
+	ToolManager->RemoveFromRoot();
+	return bSuccess ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#include "SRTrainingCheckpoint.h"
+#include "SymbolRecognizerPluginEditor.h"
+#include "Misc/FileHelper.h"
+#include "HAL/FileManager.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/ObjectAndNameAsStringProxyArchive.h"
+
+FString FSRTrainingCheckpoint::GetPath(const FString& InProfileName)
+{
+	return FSymbolRecognizerPluginEditorModule::GetPluginDir() / "Saved/Checkpoints" / InProfileName + ".srcheckpoint";
+}
+
+bool FSRTrainingCheckpoint::Save() const
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter MemoryWriter(Bytes, true);
+	FObjectAndNameAsStringProxyArchive Ar(MemoryWriter, false);
+	int32 FileVersion = Version;
+	Ar << FileVersion;
+	StaticStruct()->SerializeItem(Ar, const_cast<FSRTrainingCheckpoint*>(this), nullptr);
+
+	const FString Path = GetPath(ProfileName);
+	const FString TempPath = Path + ".tmp";
+	if (!FFileHelper::SaveArrayToFile(Bytes, *TempPath) || !IFileManager::Get().Move(*Path, *TempPath, true, true))
+	{
+		GLog->Log("Training checkpoint not saved: " + Path);
+		IFileManager::Get().Delete(*TempPath);
+		return false;
+	}
+
+	return true;
+}
+
+bool FSRTrainingCheckpoint::Load(const FString& InProfileName, FSRTrainingCheckpoint& OutCheckpoint)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *GetPath(InProfileName), FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FMemoryReader MemoryReader(Bytes, true);
+	FObjectAndNameAsStringProxyArchive Ar(MemoryReader, true);
+	int32 FileVersion = 0;
+	Ar << FileVersion;
+	if (FileVersion != Version)
+	{
+		return false;
+	}
+
+	StaticStruct()->SerializeItem(Ar, &OutCheckpoint, nullptr);
+	return !Ar.IsError() && OutCheckpoint.ProfileName == InProfileName;
+}
+
+void FSRTrainingCheckpoint::Delete(const FString& InProfileName)
+{
+	IFileManager::Get().Delete(*GetPath(InProfileName), false, false, true);
+}
@@ -0,0 +1,170 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#include "SRTrainingJob.h"
+#include "Misc/ScopeLock.h"
+#include "SRTrainingThreadPool.h"
+
+void FSRTrainingJob::ResumeFrom(const FSRTrainingCheckpoint& InCheckpoint)
+{
+	Network = InCheckpoint.Network;
+	CascadeNetwork = InCheckpoint.CascadeNetwork;
+	ResumeCheckpoint = MakeShared<const FSRTrainingCheckpoint, ESPMode::ThreadSafe>(InCheckpoint);
+	ReportProgress(0.0f, InCheckpoint.Epochs, InCheckpoint.SymbolsScores);
+}
+
+void FSRTrainingJob::CollectCalibrationInputs(TArray<TArray<float>>& OutInputs) const
+{
+	OutInputs.Reset(ImagesCount);
+	for (const FSRTrainingDataSet& TrainingSet : *TrainingSets)
+	{
+		OutInputs.Append(TrainingSet.Inputs);
+	}
+}
+
+ESRTrainingJobState FSRTrainingJob::GetState() const
+{
+	FScopeLock Lock(&StatusLock);
+	return State;
+}
+
+void FSRTrainingJob::SetState(ESRTrainingJobState InState)
+{
+	FScopeLock Lock(&StatusLock);
+	State = InState;
+}
+
+bool FSRTrainingJob::IsActive() const
+{
+	const ESRTrainingJobState CurrentState = GetState();
+	return CurrentState == ESRTrainingJobState::Queued || CurrentState == ESRTrainingJobState::Running;
+}
+
+void FSRTrainingJob::RequestStop(bool bInSaveResult)
+{
+	bSaveOnStop = bInSaveResult;
+	bStopRequested = true;
+}
+
+void FSRTrainingJob::ReportProgress(float InProgress, int32 InEpochs, const TArray<float>& InScores)
+{
+	FScopeLock Lock(&StatusLock);
+	Progress = InProgress;
+	Epochs = InEpochs;
+	Scores = InScores;
+}
+
+void FSRTrainingJob::GetProgress(float& OutProgress, int32& OutEpochs, TArray<float>& OutScores) const
+{
+	FScopeLock Lock(&StatusLock);
+	OutProgress = Progress;
+	OutEpochs = Epochs;
+	OutScores = Scores;
+}
+
+void FSRTrainingJob::SetStats(const FSRTrainingStats& InStats)
+{
+	FScopeLock Lock(&StatusLock);
+	Stats = InStats;
+}
+
+FSRTrainingStats FSRTrainingJob::GetStats() const
+{
+	FScopeLock Lock(&StatusLock);
+	return Stats;
+}
+
+////////////////////////////////////////////////////////////
+
+void FSRTrainingScheduler::Enqueue(const FSRTrainingJobRef& InJob)
+{
+	InJob->SetState(ESRTrainingJobState::Queued);
+	Jobs.Add(InJob);
+	GLog->Log("Training queued for profile: " + InJob->GetDisplayName());
+	StartQueuedJobs();
+}
+
+void FSRTrainingScheduler::Stop(const FSRTrainingJobRef& InJob, bool bInSaveResult)
+{
+	if (InJob->GetState() == ESRTrainingJobState::Queued)
+	{
+		InJob->SetState(ESRTrainingJobState::Stopped);
+		OnJobFinished(InJob);
+		return;
+	}
+
+	InJob->RequestStop(bInSaveResult);
+}
+
+void FSRTrainingScheduler::StopAll(bool bInSaveResult)
+{
+	for (const FSRTrainingJobRef& Job : TArray<FSRTrainingJobRef>(Jobs))
+	{
+		Stop(Job, bInSaveResult);
+	}
+}
+
+void FSRTrainingScheduler::OnJobFinished(const FSRTrainingJobRef& InJob)
+{
+	//delegates hold the job as payload.
+	InJob->OnComplete.Unbind();
+	InJob->OnStop.Unbind();
+	Jobs.Remove(InJob);
+	StartQueuedJobs();
+}
+
+TSharedPtr<FSRTrainingJob, ESPMode::ThreadSafe> FSRTrainingScheduler::FindActiveJob(const FString& InProfileName) const
+{
+	for (const FSRTrainingJobRef& Job : Jobs)
+	{
+		if (Job->ProfileName == InProfileName && Job->IsActive())
+		{
+			return Job;
+		}
+	}
+
+	return nullptr;
+}
+
+bool FSRTrainingScheduler::HasActiveJobs() const
+{
+	return Jobs.Num() > 0;
+}
+
+int32 FSRTrainingScheduler::GetCoresBudget() const
+{
+	return CoresBudget > 0 ? CoresBudget : FSRTrainingThreadPool::Get().GetNumThreads();
+}
+
+void FSRTrainingScheduler::StartQueuedJobs()
+{
+	int32 UsedCores = 0;
+	bool bAnyRunning = false;
+	for (const FSRTrainingJobRef& Job : Jobs)
+	{
+		if (Job->GetState() == ESRTrainingJobState::Running)
+		{
+			UsedCores += FMath::Min(Job->GetCoresCost(), GetCoresBudget());
+			bAnyRunning = true;
+		}
+	}
+
+	for (const FSRTrainingJobRef& Job : Jobs)
+	{
+		if (Job->GetState() != ESRTrainingJobState::Queued)
+		{
+			continue;
+		}
+
+		const int32 JobCores = FMath::Min(Job->GetCoresCost(), GetCoresBudget());
+		if (bAnyRunning && UsedCores + JobCores > GetCoresBudget())
+		{
+			//keep queue order, bigger job waits for cores instead of being overtaken.
+			break;
+		}
+
+		Job->SetState(ESRTrainingJobState::Running);
+		UsedCores += JobCores;
+		bAnyRunning = true;
+		GLog->Log("Training started for profile: " + Job->ProfileName);
+		(new FAutoDeleteAsyncTask<NetworkTrainingAsyncTask>(Job))->StartBackgroundTask(&FSRTrainingThreadPool::Get());
+	}
+}
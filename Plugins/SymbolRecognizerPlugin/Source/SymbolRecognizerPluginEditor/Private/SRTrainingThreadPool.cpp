@@ -0,0 +1,360 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#include "SRTrainingThreadPool.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/Event.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Misc/ScopeLock.h"
+
+TUniquePtr<FSRTrainingThreadPool> FSRTrainingThreadPool::Instance;
+
+class FSRTrainingThreadPool::FWorker : public FRunnable
+{
+public:
+	FWorker(FSRTrainingThreadPool* InPool)
+		: Pool(InPool)
+		, DoWorkEvent(FPlatformProcess::GetSynchEventFromPool())
+	{
+	}
+
+	virtual ~FWorker()
+	{
+		FPlatformProcess::ReturnSynchEventToPool(DoWorkEvent);
+	}
+
+	bool Start(int32 InIdx, uint32 InStackSize, EThreadPriority InPriority, uint64 InAffinityMask)
+	{
+		Thread = FRunnableThread::Create(this, *FString::Printf(TEXT("SRTrainingWorker%i"), InIdx), InStackSize, InPriority,
+			InAffinityMask != 0 ? InAffinityMask : FPlatformAffinity::GetNoAffinityMask());
+		return Thread != nullptr;
+	}
+
+	void Kill()
+	{
+		bTimeToDie = true;
+		DoWorkEvent->Trigger();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	//called under pool's lock on idle worker.
+	void DoWork(IQueuedWork* InWork)
+	{
+		QueuedWork = InWork;
+		FPlatformMisc::MemoryBarrier();
+		DoWorkEvent->Trigger();
+	}
+
+	virtual uint32 Run() override
+	{
+		while (!bTimeToDie)
+		{
+			DoWorkEvent->Wait();
+			IQueuedWork* Work = QueuedWork;
+			QueuedWork = nullptr;
+			FPlatformMisc::MemoryBarrier();
+			while (Work)
+			{
+				Work->DoThreadedWork();
+				Work = Pool->ReturnToPoolOrGetNextJob(this);
+			}
+		}
+
+		return 0;
+	}
+
+private:
+	FSRTrainingThreadPool* Pool;
+	FEvent* DoWorkEvent;
+	FRunnableThread* Thread = nullptr;
+	IQueuedWork* volatile QueuedWork = nullptr;
+	FThreadSafeBool bTimeToDie = false;
+};
+
+/*
+ * Takes indices of a ParallelFor until all of them are taken.
+ */
+class FSRParallelForHelper : public IQueuedWork
+{
+public:
+	FSRParallelForHelper(TFunctionRef<void(int32)>& InBody, int32 InNum, FThreadSafeCounter& InNextIndex)
+		: Body(InBody)
+		, Num(InNum)
+		, NextIndex(InNextIndex)
+		, DoneEvent(FPlatformProcess::GetSynchEventFromPool(true))
+	{
+	}
+
+	~FSRParallelForHelper()
+	{
+		FPlatformProcess::ReturnSynchEventToPool(DoneEvent);
+	}
+
+	void Run()
+	{
+		for (int32 Idx = NextIndex.Increment() - 1; Idx < Num; Idx = NextIndex.Increment() - 1)
+		{
+			Body(Idx);
+		}
+	}
+
+	virtual void DoThreadedWork() override
+	{
+		Run();
+		DoneEvent->Trigger();
+	}
+
+	virtual void Abandon() override
+	{
+		DoneEvent->Trigger();
+	}
+
+	void Wait()
+	{
+		DoneEvent->Wait();
+	}
+
+private:
+	TFunctionRef<void(int32)>& Body;
+	int32 Num;
+	FThreadSafeCounter& NextIndex;
+	FEvent* DoneEvent;
+};
+
+static EThreadPriority ToThreadPriority(ESRTrainingThreadPriority InPriority)
+{
+	switch (InPriority)
+	{
+	case ESRTrainingThreadPriority::Lowest:
+		return TPri_Lowest;
+	case ESRTrainingThreadPriority::Normal:
+		return TPri_Normal;
+	default:
+		return TPri_BelowNormal;
+	}
+}
+
+FSRTrainingThreadPool& FSRTrainingThreadPool::Get()
+{
+	if (!Instance.IsValid())
+	{
+		Instance = MakeUnique<FSRTrainingThreadPool>();
+		Instance->Configure(0, ESRTrainingThreadPriority::BelowNormal, 0);
+	}
+
+	return *Instance;
+}
+
+void FSRTrainingThreadPool::Shutdown()
+{
+	Instance.Reset();
+}
+
+FSRTrainingThreadPool::~FSRTrainingThreadPool()
+{
+	Destroy();
+}
+
+bool FSRTrainingThreadPool::Configure(int32 InThreadsCount, ESRTrainingThreadPriority InPriority, uint64 InAffinityMask)
+{
+	const int32 ThreadsCount = InThreadsCount > 0 ? InThreadsCount : FMath::Max(1, FPlatformMisc::NumberOfCoresIncludingHyperthreads() - 1);
+	const EThreadPriority Priority = ToThreadPriority(InPriority);
+	if (Workers.Num() == ThreadsCount && ThreadPriority == Priority && AffinityMask == InAffinityMask)
+	{
+		return true;
+	}
+
+	if (IsBusy())
+	{
+		return false;
+	}
+
+	Destroy();
+	AffinityMask = InAffinityMask;
+	return Create(ThreadsCount, 128 * 1024, Priority);
+}
+
+bool FSRTrainingThreadPool::IsBusy() const
+{
+	FScopeLock Lock(&QueueLock);
+	return QueuedWork.Num() > 0 || IdleWorkers.Num() != Workers.Num();
+}
+
+bool FSRTrainingThreadPool::Create(uint32 InNumQueuedThreads, uint32 InStackSize, EThreadPriority InThreadPriority)
+{
+	FScopeLock Lock(&QueueLock);
+	check(Workers.Num() == 0);
+	bDestroying = false;
+	ThreadPriority = InThreadPriority;
+
+	for (uint32 Idx = 0; Idx < InNumQueuedThreads; ++Idx)
+	{
+		FWorker* Worker = new FWorker(this);
+		if (!Worker->Start(Idx, InStackSize, InThreadPriority, AffinityMask))
+		{
+			delete Worker;
+			break;
+		}
+
+		Workers.Add(Worker);
+		IdleWorkers.Add(Worker);
+	}
+
+	GLog->Log(FString::Printf(TEXT("Training thread pool created, threads: %i"), Workers.Num()));
+	return Workers.Num() > 0;
+}
+
+void FSRTrainingThreadPool::Destroy()
+{
+	TArray<IQueuedWork*> AbandonedWork;
+	{
+		FScopeLock Lock(&QueueLock);
+		bDestroying = true;
+		AbandonedWork = MoveTemp(QueuedWork);
+		QueuedWork.Reset();
+	}
+
+	for (IQueuedWork* Work : AbandonedWork)
+	{
+		Work->Abandon();
+	}
+
+	//workers finish their current work first.
+	for (FWorker* Worker : Workers)
+	{
+		Worker->Kill();
+		delete Worker;
+	}
+
+	FScopeLock Lock(&QueueLock);
+	Workers.Reset();
+	IdleWorkers.Reset();
+}
+
+void FSRTrainingThreadPool::AddQueuedWork(IQueuedWork* InQueuedWork)
+{
+	check(InQueuedWork);
+	{
+		FScopeLock Lock(&QueueLock);
+		if (!bDestroying && Workers.Num() > 0)
+		{
+			if (IdleWorkers.Num() > 0)
+			{
+				IdleWorkers.Pop(false)->DoWork(InQueuedWork);
+			}
+			else
+			{
+				QueuedWork.Add(InQueuedWork);
+			}
+			return;
+		}
+	}
+
+	//not abandonable work runs at once on calling thread.
+	InQueuedWork->Abandon();
+}
+
+bool FSRTrainingThreadPool::RetractQueuedWork(IQueuedWork* InQueuedWork)
+{
+	FScopeLock Lock(&QueueLock);
+	return QueuedWork.RemoveSingle(InQueuedWork) > 0;
+}
+
+int32 FSRTrainingThreadPool::GetNumThreads() const
+{
+	return Workers.Num();
+}
+
+IQueuedWork* FSRTrainingThreadPool::ReturnToPoolOrGetNextJob(FWorker* InWorker)
+{
+	FScopeLock Lock(&QueueLock);
+	if (bDestroying)
+	{
+		return nullptr;
+	}
+
+	if (QueuedWork.Num() > 0)
+	{
+		IQueuedWork* Work = QueuedWork[0];
+		QueuedWork.RemoveAt(0, 1, false);
+		return Work;
+	}
+
+	IdleWorkers.Add(InWorker);
+	return nullptr;
+}
+
+void FSRTrainingThreadPool::ParallelFor(int32 InNum, TFunctionRef<void(int32)> InBody, int32 InMaxThreads)
+{
+	if (InNum <= 0)
+	{
+		return;
+	}
+
+	FThreadSafeCounter NextIndex;
+	TArray<TUniquePtr<FSRParallelForHelper>, TInlineAllocator<32>> Helpers;
+	const int32 HelpersCount = FMath::Min3(InNum - 1, GetNumThreads(), InMaxThreads > 0 ? InMaxThreads - 1 : MAX_int32);
+	for (int32 Idx = 0; Idx < HelpersCount; ++Idx)
+	{
+		Helpers.Add(MakeUnique<FSRParallelForHelper>(InBody, InNum, NextIndex));
+		AddQueuedWork(Helpers.Last().Get());
+	}
+
+	FSRParallelForHelper(InBody, InNum, NextIndex).Run();
+
+	for (TUniquePtr<FSRParallelForHelper>& Helper : Helpers)
+	{
+		if (!RetractQueuedWork(Helper.Get()))
+		{
+			Helper->Wait();
+		}
+	}
+}
+
+void FSRTrainingThreadPool::SetPaused(bool bInPaused)
+{
+	FScopeLock Lock(&PauseLock);
+	if (bPaused == bInPaused)
+	{
+		return;
+	}
+
+	if (bInPaused)
+	{
+		PauseStartTime = FPlatformTime::Seconds();
+	}
+	else
+	{
+		PausedSeconds += FPlatformTime::Seconds() - PauseStartTime;
+	}
+
+	bPaused = bInPaused;
+	GLog->Log(bInPaused ? "Trainings paused." : "Trainings resumed.");
+}
+
+void FSRTrainingThreadPool::WaitWhilePaused(TFunctionRef<bool()> InShouldStop) const
+{
+	while (bPaused && !InShouldStop())
+	{
+		FPlatformProcess::Sleep(0.05f);
+	}
+}
+
+double FSRTrainingThreadPool::GetPausedSeconds() const
+{
+	FScopeLock Lock(&PauseLock);
+	return PausedSeconds + (bPaused ? FPlatformTime::Seconds() - PauseStartTime : 0.0);
+}
+
+void FSRTrainingThreadPool::SetPauseDuringPIE(bool bInPause)
+{
+	bPauseDuringPIE = bInPause;
+	SetPaused(bPauseDuringPIE && bPlayingInEditor);
+}
+
+void FSRTrainingThreadPool::SetPlayingInEditor(bool bInPlaying)
+{
+	bPlayingInEditor = bInPlaying;
+	SetPaused(bPauseDuringPIE && bPlayingInEditor);
+}
@@ -12,6 +12,8 @@
 #include "SRToolWidget.h"
 #include "Editor/UnrealEd/Classes/Settings/ProjectPackagingSettings.h"
 #include "Engine/EngineTypes.h"
+#include "Editor.h"
+#include "SRTrainingThreadPool.h"
 
 static const FName SymbolRecognizerPluginEditorTabName("SymbolRecognizer");
 const FString FSymbolRecognizerPluginEditorModule::SRDirectoryToAlwaysCook = "/SymbolRecognizerPlugin/Content";
@@ -80,6 +82,8 @@ void FSymbolRecognizerPluginEditorModule::StartupModule()
 		.SetDisplayName(LOCTEXT("FSymbolRecognizerPluginEditorTabTitle", "SymbolRecognizerPluginEditor"))
 		.SetMenuType(ETabSpawnerMenuType::Hidden);
 
+	BeginPIEHandle = FEditorDelegates::BeginPIE.AddRaw(this, &FSymbolRecognizerPluginEditorModule::OnPIEChanged, true);
+	EndPIEHandle = FEditorDelegates::EndPIE.AddRaw(this, &FSymbolRecognizerPluginEditorModule::OnPIEChanged, false);
 }
 
 void FSymbolRecognizerPluginEditorModule::ShutdownModule()
@@ -97,7 +101,18 @@ void FSymbolRecognizerPluginEditorModule::ShutdownModule()
 		PropertyModule.UnregisterCustomClassLayout("SRToolManager");
 	}
 
+	FEditorDelegates::BeginPIE.Remove(BeginPIEHandle);
+	FEditorDelegates::EndPIE.Remove(EndPIEHandle);
+
 	CleanupOnClosed();
+
+	//trainings were stopped above, wait for them to leave the pool.
+	FSRTrainingThreadPool::Shutdown();
+}
+
+void FSymbolRecognizerPluginEditorModule::OnPIEChanged(const bool bIsSimulating, bool bInPlaying)
+{
+	FSRTrainingThreadPool::Get().SetPlayingInEditor(bInPlaying);
 }
 
 void FSymbolRecognizerPluginEditorModule::OnPluginTabClosed(TSharedRef<class SDockTab> InTab)
@@ -0,0 +1,80 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#pragma once
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+#include "SREpochSampler.generated.h"
+
+struct FSRDMatrix;
+
+/*
+ * Order in which training images are visited during an epoch.
+ */
+UENUM(NotBlueprintable)
+enum class ESRSamplingMode : uint8
+{
+	//All images of the first symbol, then the second one... (symbols interleaved in parallel training modes).
+	Sequential = 0,
+	//New random order of all images every epoch.
+	Shuffle,
+	//Round robin over shuffled symbols, images of every symbol shuffled, so every part of the epoch has all symbols in.
+	Stratified,
+	//Stratified, images answered wrong (or barely right) in the last evaluation are repeated, half of the solved ones are skipped.
+	HardExamples
+};
+
+enum class ESRSampleHardness : uint8
+{
+	Unknown,
+	Solved,
+	BarelyRight,
+	Wrong
+};
+
+class SYMBOLRECOGNIZERPLUGINEDITOR_API FSREpochSampler
+{
+public:
+	static const int32 WrongRepeats = 3;
+	static const int32 BarelyRightRepeats = 2;
+	static constexpr float SolvedKeepRatio = 0.5f;
+
+	/*
+	* @ InSamplesPerSet images count of every symbol.
+	* @ bInInterleaveSequential Sequential mode visits symbols round robin.
+	*/
+	void Init(const TArray<int32>& InSamplesPerSet, ESRSamplingMode InMode, bool bInInterleaveSequential, int32 InSeed);
+	/*
+	* @ OutOrder (symbol, image) pairs to train in the next epoch.
+	*/
+	void BuildEpoch(TArray<TPair<int32, int32>>& OutOrder);
+
+	FORCEINLINE ESRSamplingMode GetMode() const { return Mode; }
+	FORCEINLINE bool NeedsHardness() const { return Mode == ESRSamplingMode::HardExamples; }
+	void SetHardness(int32 InSetIdx, int32 InInputIdx, ESRSampleHardness InHardness);
+	/*
+	* Random stream position and hardness of all samples, so training can be resumed with the same order.
+	*/
+	void GetState(int32& OutSeed, TArray<uint8>& OutHardness) const;
+	/*
+	* Must be called after Init, hardness is ignored when images count differs.
+	*/
+	void SetState(int32 InSeed, const TArray<uint8>& InHardness);
+
+	/*
+	* @ InResult output of Query for the image.
+	* @ InAcceptableAccuracy, InDeltaBestAnswers the same as in FSRNeuralNetwork::GetQueryResult.
+	*/
+	static ESRSampleHardness GetHardness(const FSRDMatrix& InResult, int32 InAnswer, float InAcceptableAccuracy, float InDeltaBestAnswers);
+
+private:
+	ESRSamplingMode Mode = ESRSamplingMode::Sequential;
+	bool bInterleaveSequential = false;
+	FRandomStream Random;
+	TArray<int32> SamplesPerSet;
+	//index of the first image of every symbol in Hardness.
+	TArray<int32> SetOffsets;
+	TArray<ESRSampleHardness> Hardness;
+
+	int32 GetRepeats(int32 InSetIdx, int32 InInputIdx);
+	template<typename T>
+	void Shuffle(TArray<T>& InOutArray);
+};
@@ -0,0 +1,86 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#pragma once
+#include "CoreMinimal.h"
+#include "SRTrainingJob.h"
+#include "SRHyperparameterSweep.generated.h"
+
+UENUM(NotBlueprintable)
+enum class ESRSweepMode : uint8
+{
+	//every combination of the listed values.
+	Grid = 0,
+	//RandomConfigurations picked between the smallest and the biggest listed values.
+	Random
+};
+
+USTRUCT(NotBlueprintable)
+struct SYMBOLRECOGNIZERPLUGINEDITOR_API FSRSweepSettings
+{
+	GENERATED_BODY()
+
+	UPROPERTY(config, EditAnywhere, Category = "Sweep")
+	ESRSweepMode Mode = ESRSweepMode::Grid;
+	UPROPERTY(config, EditAnywhere, Category = "Sweep", meta = (ClampMin = "1", ClampMax = "1000"))
+	TArray<int32> HiddenNodes = { 32, 64, 128, 250 };
+	UPROPERTY(config, EditAnywhere, Category = "Sweep", meta = (ClampMin = "0.01", ClampMax = "0.99"))
+	TArray<float> LearningRates = { 0.1f, 0.2f };
+	/*
+	* Every candidate trains this many epochs (auto training is not used, so all candidates finish).
+	*/
+	UPROPERTY(config, EditAnywhere, Category = "Sweep", meta = (ClampMin = "1", ClampMax = "10000"))
+	TArray<int32> LearningCycles = { 100, 200 };
+	UPROPERTY(config, EditAnywhere, Category = "Sweep", meta = (ClampMin = "1", ClampMax = "256", EditCondition = "Mode == ESRSweepMode::Random"))
+	int32 RandomConfigurations = 8;
+	UPROPERTY(config, EditAnywhere, Category = "Sweep", meta = (EditCondition = "Mode == ESRSweepMode::Random"))
+	int32 RandomSeed = 0;
+};
+
+struct FSRSweepCandidate
+{
+	int32 HiddenNodes = 0;
+	float LearningRate = 0.0f;
+	int32 LearningCycles = 0;
+
+	TSharedPtr<FSRTrainingJob, ESPMode::ThreadSafe> Job;
+	//results, valid when bFinished.
+	bool bFinished = false;
+	bool bPassed = false;
+	float Accuracy = 0.0f;
+	double TrainSeconds = 0.0;
+	int64 InferenceFlops = 0;
+
+	FString GetLabel() const;
+};
+
+/*
+ * Trains many configurations of one profile at the same time (one core each) on the same decoded images
+ * and picks the network that is the cheapest to query among the ones reaching AcceptableTrainingAccuracy.
+ * Game thread only.
+ */
+class SYMBOLRECOGNIZERPLUGINEDITOR_API FSRHyperparameterSweep
+{
+public:
+	FString ProfileName;
+	TArray<FSRSweepCandidate> Candidates;
+	//USRToolManager::ComputeImagesHash of the images candidates were trained on.
+	uint32 ImagesHash = 0;
+
+	/*
+	* Fills Candidates with configurations described by InSettings.
+	* @ return false when InSettings describe no configuration.
+	*/
+	bool BuildCandidates(const FSRSweepSettings& InSettings);
+	FSRSweepCandidate* FindCandidate(const FSRTrainingJobRef& InJob);
+	/*
+	* Reads results of InJob's candidate, InJob must be finished.
+	*/
+	void OnJobFinished(const FSRTrainingJobRef& InJob);
+	bool IsFinished() const;
+	/*
+	* @ return passing candidate with the fewest inference FLOPs (higher accuracy wins a tie), nullptr when none passed.
+	*/
+	const FSRSweepCandidate* GetBestCandidate() const;
+	void LogResults() const;
+};
+
+typedef TSharedRef<FSRHyperparameterSweep> FSRHyperparameterSweepRef;
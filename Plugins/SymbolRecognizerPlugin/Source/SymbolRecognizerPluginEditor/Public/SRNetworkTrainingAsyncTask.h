@@ -1,12 +1,32 @@
 // Copyright 2019 Piotr Macharzewski. All Rights Reserved.
 #pragma once
 #include "Runtime/Core/Public/Async/AsyncWork.h"
+#include "Async/Future.h"
+#include "SRNeuralNetwork.h"
+#include "SREpochSampler.h"
+#include "SRTrainingThreadPool.h"
+#include "SRSampleAugmenter.h"
 #include "SRNetworkTrainingAsyncTask.generated.h"
 
 DECLARE_DELEGATE(FTrainingTaskCompleteDelegate);
 DECLARE_DELEGATE(FTrainingTaskStopDelegate);
 
 struct FSRNeuralNetwork;
+class FSRTrainingJob;
+
+/*
+ * How training samples of an epoch are spread over threads.
+ */
+UENUM(NotBlueprintable)
+enum class ESRTrainingParallelism : uint8
+{
+	//Sample by sample on one thread (the same results on every run).
+	SingleThread = 0,
+	//Mini-batches split between threads, gradients summed in local buffers and applied once per batch (the same results with any threads count).
+	DataParallel,
+	//Every thread trains its samples straight on shared weights without locks (fastest, results vary between runs).
+	Hogwild
+};
 
 /*
  * Stores training data for single symbol e.g. Symbol 'A' has 5 images,
@@ -21,6 +41,8 @@ struct SYMBOLRECOGNIZERPLUGINEDITOR_API FSRTrainingDataSet
 	int32 Outputs;
 	int32 Answer;//symbol id
 	TArray<float> ExpectedOutput;
+	//strokes of every input, only for StrokeDirections encoding (augmentation encodes them again).
+	TArray<TArray<FSRDrawLine>> Strokes;
 	FSRTrainingDataSet() {};
 	FSRTrainingDataSet(TArray<TArray<float>>& InInputs, int32 InOutputs, int32 InAnswer)
 		: Inputs(InInputs)
@@ -41,42 +63,106 @@ struct SYMBOLRECOGNIZERPLUGINEDITOR_API FSRTrainingDataSet
 
 };
 
+/*
+ * Accuracy of a network snapshot measured on training images.
+ */
+struct FSREvaluationResult
+{
+	TSharedPtr<FSRNeuralNetwork, ESPMode::ThreadSafe> Snapshot;
+	int32 Epochs = 0;
+	float Accuracy = 0.0f;
+	TArray<float> SymbolsScores;
+	//mean squared error of outputs.
+	float Loss = 0.0f;
+	//wall time of the evaluation (forward passes only).
+	double Seconds = 0.0;
+	//time of the forward passes summed over workers, the same for any workers count.
+	double ForwardSeconds = 0.0;
+	//per evaluated sample, filled only when sampler needs it.
+	TArray<ESRSampleHardness> Hardness;
+};
+
+/*
+ * Throughput of a training, published after every epoch.
+ * Training steps are fused, so only their wall time per sample is known. Forward is measured by evaluation on the workers.
+ */
+struct FSRTrainingStats
+{
+	int32 Epochs = 0;
+	int32 EpochSamples = 0;
+	float SamplesPerSecond = 0.0f;
+	double EpochSeconds = 0.0;
+	//sum of EpochSeconds of this run (without pauses).
+	double TotalSeconds = 0.0;
+	double TrainSeconds = 0.0;
+	//wall time of the epoch's training steps divided by its samples (all threads together).
+	double TrainSecondsPerSample = 0.0;
+	//time of one forward pass on a single worker.
+	double ForwardSecondsPerSample = 0.0;
+	//time of the last evaluation (runs next to training) and the time training waited for it.
+	double EvaluationSeconds = 0.0;
+	double EvaluationWaitSeconds = 0.0;
+	//time epoch waited for its augmented inputs.
+	double AugmentationWaitSeconds = 0.0;
+	int32 EvaluatedEpochs = 0;
+	float Loss = 0.0f;
+	float Accuracy = 0.0f;
+	//negative when unknown (auto training without progress).
+	double EstimatedSecondsLeft = -1.0;
+	//FSRNeuralNetwork::GetWeightsCrc of the result, set when training is completed.
+	uint32 WeightsCrc = 0;
+};
+
 class SYMBOLRECOGNIZERPLUGINEDITOR_API NetworkTrainingAsyncTask : public FNonAbandonableTask
 {
 	friend class USRToolManager;
 
+	//owns settings, result networks, progress and stop flag of this training.
+	TSharedRef<FSRTrainingJob, ESPMode::ThreadSafe> Job;
+	//runs this task and its parallel loops.
+	FSRTrainingThreadPool& Pool;
 	FSRNeuralNetwork& NeuralItem;
-	UPROPERTY()
-	TArray<FSRTrainingDataSet> TrainigsSet;
+	FSRNeuralNetwork* CascadeItem;
+	uint32 CascadeHidden;
+	//wih is a shared trunk, only who is trained.
+	bool bTrainOutputLayerOnly;
+	ESRTrainingParallelism Parallelism;
+	int32 ThreadsCount;
+	int32 BatchSize;
+	//(training set, input) pairs in order of training, rebuilt by Sampler every epoch.
+	TArray<TPair<int32, int32>> SamplesOrder;
+	FSREpochSampler Sampler;
+	ESRSamplingMode SamplingMode;
+	int32 RandomSeed;
+	TArray<FSRGradientBuffer> GradientBuffers;
+	const TArray<FSRTrainingDataSet>& TrainigsSet;
 	int32 Outputs;
 	int32 AllImagesCount;
-	uint32 Inputs;
 	uint32 Hidden;
-	float Lr;
 	int32 EpochsLimit;// if <= 0 then autotraining until Accuracy is reached
 	float AcceptableAccuracy;
 	float DeltaBestAnswers;
-	FTrainingTaskCompleteDelegate TrainingTaskComplete;
-	FTrainingTaskStopDelegate TrainingTaskStop;
-	static FThreadSafeBool bShouldStopSymbolTraining;
-	static float Progress;
-	static int32 CurrentEpochs;
-	static TArray<float> SymbolsScores;
+	TArray<float> SymbolsScores;
+	int32 EvaluationInterval;
+	int32 CheckpointInterval;
+	FSRTrainingStats Stats;
+	//accuracy of the evaluation before the last one, used to estimate auto training time.
+	float PreviousAccuracy = -1.0f;
+	int32 PreviousEvaluatedEpochs = 0;
+	//plugin's Saved/TrainingStats/<profile>.csv
+	FString StatsCsvPath;
+	//(training set, input) pairs used to measure accuracy, every symbol has the same part of its images in.
+	TArray<TPair<int32, int32>> EvaluationSamples;
+	TArray<int32> EvaluationSamplesPerSet;
+	//distorted inputs of the current epoch, evaluation reads TrainigsSet.
+	FSRAugmentationPipeline Augmentation;
+
+	//gradient buffers of a DataParallel batch, also the max threads it uses.
+	static constexpr int32 MaxGradientSlots = 16;
+	static constexpr int32 EvaluationChunks = 32;
 public:
 
-	NetworkTrainingAsyncTask(
-			FSRNeuralNetwork& InNeuralItem
-		, TArray<FSRTrainingDataSet>& InTrainigsSet
-		, int32 InSymbolsCount
-		, int32 InAllImagesCount
-		, uint32 InInputs
-		, uint32 InHidden
-		, float InLr
-		, int32 InEpochsLimit
-		, float InAcceptableAccuracy, float InDeltaBestAnswers
-		, FTrainingTaskCompleteDelegate InTrainingTaskComplete
-		, FTrainingTaskStopDelegate InTrainingTaskStop
-	);
+	NetworkTrainingAsyncTask(const TSharedRef<FSRTrainingJob, ESPMode::ThreadSafe>& InJob);
 
 	FORCEINLINE TStatId GetStatId() const
 	{
@@ -84,4 +170,31 @@ public:
 	}
 
 	void DoWork();
+
+private:
+	//@ return false when training was stopped.
+	bool TrainEpochSingleThread();
+	bool TrainEpochDataParallel();
+	bool TrainEpochHogwild();
+	bool IsStopRequested() const;
+	//input trained in current epoch (augmented when enabled).
+	FORCEINLINE const TArray<float>& GetTrainingInput(const TPair<int32, int32>& InSample) const
+	{
+		return Augmentation.IsEnabled() ? Augmentation.GetInput(InSample.Key, InSample.Value) : TrainigsSet[InSample.Key].Inputs[InSample.Value];
+	}
+	//blocks while trainings are paused (e.g. during PIE).
+	void WaitWhilePaused() const;
+	/*
+	* Copies current weights and measures their accuracy in the background (evaluated in chunks on the training pool), so training can go on meanwhile.
+	*/
+	TFuture<FSREvaluationResult> StartEvaluation(int32 InEpochs) const;
+	FSREvaluationResult Evaluate(const TSharedPtr<FSRNeuralNetwork, ESPMode::ThreadSafe>& InSnapshot, int32 InEpochs) const;
+	void ReportEvaluation(const FSREvaluationResult& InResult, bool bAutoTraining, int32 InEpochs);
+	void SaveCheckpoint(int32 InEpochs) const;
+	void PublishStats(bool bAutoTraining);
+	void WriteStatsCsv() const;
+	void TrainCascade(const TArray<float>& InInput, const TArray<float>& InExpectedOutput);
+	//prunes the final network here, so saving it on game thread doesn't fine-tune it.
+	void BuildPrunedNetwork();
+	void BreakTask();
 };
\ No newline at end of file
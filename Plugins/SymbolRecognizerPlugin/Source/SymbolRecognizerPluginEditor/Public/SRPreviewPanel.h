@@ -26,6 +26,8 @@ public:
 	void Construct(const FArguments& InArgs, class USRToolManager* InTool);
 	void OnSymbolsListRefreshed();
 	FReply OnTrainNetwork();
+	FReply OnTrainAllProfiles();
+	FReply OnSweepParams();
 	FReply OnShowAccuracyPanel();
 	FReply OnSaveClick();
 	FReply OnClearCanvasClick();
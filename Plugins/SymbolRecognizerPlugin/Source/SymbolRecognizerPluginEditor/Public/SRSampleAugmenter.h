@@ -0,0 +1,95 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#pragma once
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "SRCanvasHandler.h"
+#include "SRSampleAugmenter.generated.h"
+
+struct FSRTrainingDataSet;
+class FSRTrainingThreadPool;
+
+/*
+ * Random distortions applied to training images every epoch.
+ */
+USTRUCT(NotBlueprintable)
+struct SYMBOLRECOGNIZERPLUGINEDITOR_API FSRAugmentationSettings
+{
+	GENERATED_BODY()
+
+	/*
+	* Train on randomly distorted copies of the images, different in every epoch, so fewer drawings are needed.
+	* Accuracy is still measured on the drawn images.
+	*/
+	UPROPERTY(EditAnywhere, config, Category = "Augmentation")
+	bool bEnabled = false;
+	//max rotation in degrees.
+	UPROPERTY(EditAnywhere, config, meta = (ClampMin = "0", ClampMax = "45", EditCondition = "bEnabled"), Category = "Augmentation")
+	float Rotation = 10.0f;
+	//max change of size, 0.1 means 90% - 110%.
+	UPROPERTY(EditAnywhere, config, meta = (ClampMin = "0", ClampMax = "0.5", EditCondition = "bEnabled"), Category = "Augmentation")
+	float Scale = 0.1f;
+	UPROPERTY(EditAnywhere, config, meta = (ClampMin = "0", ClampMax = "0.5", EditCondition = "bEnabled"), Category = "Augmentation")
+	float Shear = 0.1f;
+	//max shift as part of image size.
+	UPROPERTY(EditAnywhere, config, meta = (ClampMin = "0", ClampMax = "0.3", EditCondition = "bEnabled"), Category = "Augmentation")
+	float Shift = 0.08f;
+	//max displacement of smooth local distortion as part of image size.
+	UPROPERTY(EditAnywhere, config, meta = (ClampMin = "0", ClampMax = "0.2", EditCondition = "bEnabled"), Category = "Augmentation")
+	float Elastic = 0.04f;
+	/*
+	* Max change of strokes thickness (1 = about one pixel). Used with Pixels input encoding only,
+	* StrokeDirections descriptor doesn't depend on thickness.
+	*/
+	UPROPERTY(EditAnywhere, config, meta = (ClampMin = "0", ClampMax = "1", EditCondition = "bEnabled"), Category = "Augmentation")
+	float Thickness = 0.5f;
+};
+
+/*
+ * Distortions of single samples. The same InRandom state gives the same result.
+ */
+struct SYMBOLRECOGNIZERPLUGINEDITOR_API FSRSampleAugmenter
+{
+	/*
+	* Warps square grayscale image (ink is bright) of InPixels.Num() pixels.
+	*/
+	static void AugmentPixels(const TArray<float>& InPixels, TArray<float>& OutPixels, const FSRAugmentationSettings& InSettings, FRandomStream& InRandom);
+	/*
+	* Moves points of InLines and encodes them again with FSRStrokeEncoder.
+	* @ return false when there is nothing drawn.
+	*/
+	static bool AugmentStrokes(const TArray<FSRDrawLine>& InLines, TArray<float>& OutDescriptor, const FSRAugmentationSettings& InSettings, FRandomStream& InRandom);
+};
+
+/*
+ * Prepares distorted inputs of the next epoch on the training pool while current epoch is trained.
+ * Every sample of every epoch has its own random seed, so results don't depend on threads count.
+ */
+class SYMBOLRECOGNIZERPLUGINEDITOR_API FSRAugmentationPipeline
+{
+public:
+	~FSRAugmentationPipeline();
+
+	void Init(const TArray<FSRTrainingDataSet>& InTrainingSets, const FSRAugmentationSettings& InSettings, int32 InSeed, FSRTrainingThreadPool& InPool);
+	FORCEINLINE bool IsEnabled() const { return TrainingSets != nullptr; }
+	/*
+	* Makes inputs of InEpoch current and starts preparing InEpoch + 1.
+	* @ return seconds spent waiting for inputs that weren't ready.
+	*/
+	double BeginEpoch(int32 InEpoch);
+	FORCEINLINE const TArray<float>& GetInput(int32 InSetIdx, int32 InInputIdx) const { return Current[InSetIdx][InInputIdx]; }
+
+private:
+	const TArray<FSRTrainingDataSet>* TrainingSets = nullptr;
+	FSRTrainingThreadPool* Pool = nullptr;
+	FSRAugmentationSettings Settings;
+	int32 Seed = 0;
+
+	//[training set][input]
+	TArray<TArray<TArray<float>>> Current;
+	TArray<TArray<TArray<float>>> Next;
+	TFuture<void> Pending;
+	int32 PendingEpoch = INDEX_NONE;
+
+	void StartEpoch(int32 InEpoch);
+	void Generate(int32 InEpoch, TArray<TArray<TArray<float>>>& OutInputs) const;
+};
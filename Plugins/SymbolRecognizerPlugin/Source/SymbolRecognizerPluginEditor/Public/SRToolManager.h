@@ -2,6 +2,10 @@
 #pragma once
 #include "Runtime/CoreUObject/Public/UObject/Object.h"
 #include "SRNeuralNetwork.h"
+#include "SRRecognizerBackend.h"
+#include "SRNetworkTrainingAsyncTask.h"
+#include "SRTrainingJob.h"
+#include "SRHyperparameterSweep.h"
 #include "SRToolManager.generated.h"
 
 
@@ -111,8 +115,9 @@ struct SYMBOLRECOGNIZERPLUGINEDITOR_API FSRProfileData
 	/*
 	* Number of patters that the system will learn to recognize.
 	* e.g. You want the program to tell apart given letters(symbols) 'A B and C' then the value should be set to 3.
+	* For more than ~100 symbols consider OutputGroupSize.
 	*/
-	UPROPERTY(EditDefaultsOnly, config, meta = (ClampMin = "0", ClampMax = "100", UIMin = "0", UIMax = "100"), Category = "Params")
+	UPROPERTY(EditDefaultsOnly, config, meta = (ClampMin = "0", ClampMax = "1000", UIMin = "0", UIMax = "1000"), Category = "Params")
 	int32 SymbolsAmount = 10;
 
 	/*
@@ -122,6 +127,24 @@ struct SYMBOLRECOGNIZERPLUGINEDITOR_API FSRProfileData
 	UPROPERTY(EditDefaultsOnly, config, meta = (ClampMin = "2", ClampMax = "100", UIMin = "2", UIMax = "100"), Category = "Params")
 	int32 ImagesPerSymbol = 5;
 	/*
+	* Method used to recognize symbols of this profile.
+	* PointCloud compares drawing with saved images strokes and needs no training, works best with small sets of symbols.
+	*/
+	UPROPERTY(EditAnywhere, config, Category = "Params")
+	ESRRecognizerBackend RecognizerBackend = ESRRecognizerBackend::NeuralNetwork;
+	/*
+	* Point cloud matching ignores rotation of the drawing (symbols that differ only by rotation can't be told apart).
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, Category = "Params")
+	bool bPointCloudRotationInvariant = false;
+	/*
+	* Data fed to the network.
+	* StrokeDirections uses a 128 values descriptor of saved strokes instead of 28x28 pixels, so the network is much smaller
+	* and recognizing doesn't read the canvas texture. Images saved before strokes were recorded are skipped.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, Category = "Params")
+	ESRInputEncoding InputEncoding = ESRInputEncoding::Pixels;
+	/*
 	* Learn until certain accuracy is reached (AcceptableTrainingAccuracy).
 	* Automate learning may last longer (in some cases it may never end).
 	*/
@@ -159,6 +182,118 @@ struct SYMBOLRECOGNIZERPLUGINEDITOR_API FSRProfileData
 	*/
 	UPROPERTY(EditAnywhere, AdvancedDisplay, meta = (ClampMin = "0", ClampMax = "1", UIMin = "0", UIMax = "1"), config, Category = "Params")
 	float DeltaTwoBestOutcomes = 0.9f;
+	/*
+	* Spread training over threads. DataParallel trains on mini-batches (see TrainingBatchSize),
+	* Hogwild trains sample by sample on all threads at once, so results differ slightly between runs.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, Category = "Params")
+	ESRTrainingParallelism TrainingParallelism = ESRTrainingParallelism::SingleThread;
+	/*
+	* Threads used by parallel training, 0 means all logical cores.
+	* DataParallel computes gradients on at most Min(TrainingBatchSize, 16) of them, the rest only help to apply the update.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, meta = (ClampMin = "0", ClampMax = "256", UIMin = "0", UIMax = "64"), Category = "Params")
+	int32 TrainingThreads = 0;
+	/*
+	* Samples per weights update in DataParallel mode. Bigger batches use threads better but need more epochs.
+	* Every batch is split into at most 16 parts (one thread each), so batches of 1-2 samples train almost single threaded.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, meta = (ClampMin = "1", ClampMax = "1024", UIMin = "1", UIMax = "256"), Category = "Params")
+	int32 TrainingBatchSize = 32;
+	/*
+	* Order of training images in every epoch. HardExamples repeats images the network still gets wrong
+	* and skips part of already solved ones (uses results of accuracy measured every EvaluationInterval).
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, Category = "Params")
+	ESRSamplingMode TrainingSampling = ESRSamplingMode::Sequential;
+	/*
+	* Seed of initial weights, order of images and augmentation. The same seed, params and images give a bit-identical network
+	* (CRC of weights is printed to the log) with SingleThread and DataParallel at any TrainingThreads. Hogwild results still vary.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, Category = "Params")
+	int32 RandomSeed = 0;
+	/*
+	* Accuracy on training images is measured every N epochs on a copy of the network, while next epoch is trained.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, meta = (ClampMin = "1", ClampMax = "100", UIMin = "1", UIMax = "10"), Category = "Params")
+	int32 EvaluationInterval = 1;
+	/*
+	* Part of every symbol's images used to measure accuracy while training (1 = all images).
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, meta = (ClampMin = "0.01", ClampMax = "1", UIMin = "0.01", UIMax = "1"), Category = "Params")
+	float EvaluationSampleRatio = 1.0f;
+	/*
+	* Unfinished training is saved every N epochs to plugin's Saved/Checkpoints, so it can be resumed (cancelled training resumes from the last one). 0 disables checkpoints.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, meta = (ClampMin = "0", ClampMax = "1000", UIMin = "0", UIMax = "50"), Category = "Params")
+	int32 CheckpointInterval = 5;
+	/*
+	* Random distortions of training images (prepared on worker threads while previous epoch trains).
+	* Helps when there are few images per symbol and training doesn't reach AcceptableTrainingAccuracy.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, Category = "Params")
+	FSRAugmentationSettings Augmentation;
+
+	/*
+	* Activation function of the hidden layer.
+	* ReLU avoids exponent calculations so it usually trains and recognizes faster than Sigmoid.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, Category = "Params")
+	ESRActivationFunc HiddenActivation = ESRActivationFunc::Sigmoid;
+	/*
+	* Activation function of the output layer. Sigmoid works best with the default accuracy thresholds.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, Category = "Params")
+	ESRActivationFunc OutputActivation = ESRActivationFunc::Sigmoid;
+	/*
+	* Two-level output for large symbol sets: the network first picks a group of this many symbols, then a symbol inside it.
+	* Output layer then evaluates SymbolsAmount / OutputGroupSize + OutputGroupSize nodes instead of SymbolsAmount, lowest (about 2 * sqrt(SymbolsAmount)) when
+	* OutputGroupSize is around sqrt(SymbolsAmount), so its cost still grows with sqrt of symbols count. Hidden layer cost doesn't change. 0 disables it.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, meta = (ClampMin = "0", ClampMax = "100", UIMin = "0", UIMax = "100"), Category = "Params")
+	int32 OutputGroupSize = 0;
+	/*
+	* Train a very small network alongside the main one and run it first when recognizing.
+	* The main network is skipped when the small one is confident enough (see CascadeExitMargin).
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, Category = "Params")
+	bool bUseCascade = false;
+	/*
+	* Complexity of the hidden layer of the cascade first stage.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, meta = (ClampMin = "1", ClampMax = "100", UIMin = "1", UIMax = "100", EditCondition = "bUseCascade"), Category = "Params")
+	int32 CascadeHiddenNodes = 16;
+	/*
+	* Difference between two best answers of the first stage required to skip the main network.
+	* Higher value is safer but exits early less often (early exit rate is printed to the log).
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, meta = (ClampMin = "0", ClampMax = "1", UIMin = "0", UIMax = "1", EditCondition = "bUseCascade"), Category = "Params")
+	float CascadeExitMargin = 0.8f;
+	/*
+	* After training convert the network to int8 (calibrated on the training images).
+	* Agreement rate with the float network is printed to the log.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, Category = "Params")
+	bool bBuildQuantizedNetwork = true;
+	/*
+	* After training build a pruned network without this fraction of hidden nodes (0 disables it).
+	* Slow devices can pick it at runtime, see USymbolRecognizer::bSelectModelByLatency.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, meta = (ClampMin = "0", ClampMax = "0.95", UIMin = "0", UIMax = "0.95"), Category = "Params")
+	float PrunedHiddenRatio = 0.0f;
+	/*
+	* Profiles with the same SharedTrunk share one hidden layer and store only their output layer, so extra profiles take a few KB
+	* and changing between them copies only the output layer. They must use the same InputEncoding, HiddenNodes and HiddenActivation.
+	* The first profile trained with a new name trains the trunk, others train only their output layer. None disables sharing.
+	* Not used with OutputGroupSize, int8 and pruned networks (they would copy the trunk).
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, Category = "Params")
+	FName SharedTrunk;
+	/*
+	* Train the whole network again and replace the shared trunk. Other profiles of this trunk must be trained again.
+	*/
+	UPROPERTY(EditAnywhere, AdvancedDisplay, config, Category = "Params")
+	bool bRetrainSharedTrunk = false;
 
 	UPROPERTY(EditAnywhere, Category = "Save")
 	FString TrainingDataImgName = "Tex";
@@ -198,6 +333,33 @@ public:
 	int32 CurrentProfileDataID = 0;
 	UPROPERTY(config, EditAnywhere, Category = "Hidden")
 	TArray<FSRProfileData> Profiles;
+	/*
+	* Logical cores shared by concurrent trainings (0 = all cores). Queued trainings wait until running ones free their cores.
+	*/
+	UPROPERTY(config, EditAnywhere, Category = "Training", meta = (ClampMin = "0"))
+	int32 TrainingCoresBudget = 0;
+	/*
+	* Threads of the plugin's training pool (0 = all logical cores but one). Applied when no training runs.
+	*/
+	UPROPERTY(config, EditAnywhere, Category = "Training", meta = (ClampMin = "0"))
+	int32 TrainingPoolThreads = 0;
+	UPROPERTY(config, EditAnywhere, Category = "Training")
+	ESRTrainingThreadPriority TrainingThreadPriority = ESRTrainingThreadPriority::BelowNormal;
+	/*
+	* Bit per logical core training threads can run on (0 = any core), e.g. 65520 (0xFFF0) leaves the first 4 cores to the editor.
+	*/
+	UPROPERTY(config, EditAnywhere, Category = "Training", meta = (ClampMin = "0"))
+	int64 TrainingAffinityMask = 0;
+	/*
+	* Trainings wait while Play In Editor session runs, so the game gets all cores.
+	*/
+	UPROPERTY(config, EditAnywhere, Category = "Training")
+	bool bPauseTrainingDuringPIE = true;
+	/*
+	* Configurations tried by StartSweep.
+	*/
+	UPROPERTY(config, EditAnywhere, Category = "Training")
+	FSRSweepSettings SweepSettings;
 	
 	FORCEINLINE int32 GetCurrentProfileDataID() { return CurrentProfileDataID; }
 	FORCEINLINE FSRProfileData& GetCurrentProfileRef() { return Profiles[CurrentProfileDataID]; }
@@ -258,20 +420,64 @@ public:
 	/////////////////////////////////////////////////
 	int32 GetInputNodesCount() const;
 
-	FORCEINLINE bool GetIsTraningNetwork() const { return bIsTraining; }
-	void TrainNetwork();
+	/*
+	* True when current profile has queued or running training.
+	*/
+	bool GetIsTraningNetwork() const;
+	/*
+	* Queues training of current profile, it starts when scheduler has free cores.
+	* Skipped when saved network was trained on the same images and params, unless bForce.
+	* @ bAskToResume shows popup when compatible checkpoint exists or training is skipped, otherwise it's done without asking.
+	*/
+	void TrainNetwork(bool bAskToResume = true, bool bForce = false);
+	/*
+	* Queues training of every profile that isn't being trained already or up to date (resumed from checkpoints when possible).
+	*/
+	void TrainAllProfiles();
+	/*
+	* Trains SweepSettings configurations of current profile at the same time. When all finish, the passing network
+	* with the fewest inference FLOPs is saved and its HiddenNodes, LearningRate and LearningCycles are set in the profile.
+	* @ return nullptr when sweep can't start (reason is logged).
+	*/
+	TSharedPtr<FSRHyperparameterSweep> StartSweep();
 
 	void CollectDataForTrainingSet(TArray<TArray<float>>& OutData, const TArray<FString>& Images);//move
 	bool LoadTrainDataFromTexture(FString InFilePath, TArray<float>& OutData, bool bAppendPNG = true);//move
+	/*
+	* Collects network inputs of all symbol's images using current profile's InputEncoding.
+	* @ OutStrokes strokes of every input, filled with StrokeDirections encoding only.
+	*/
+	void CollectInputsForSymbol(TArray<TArray<float>>& OutData, int32 InSymbolId, TArray<TArray<FSRDrawLine>>* OutStrokes = nullptr);
 
-	void OnTrainingComplete();
-	void OnTrainingStop();
+	/*
+	* Store model variants of InJob's network in current profile (int8 one is calibrated on InJob's decoded images, pruned one was built by the training task).
+	*/
+	void BuildQuantizedNetwork(const FSRTrainingJob& InJob);
+	void SavePrunedNetwork(const FSRTrainingJob& InJob);
+	/*
+	* Prepares point cloud templates: images saved without strokes are converted from pixels.
+	*/
+	void BuildStrokeTemplates();
+	//called on the worker thread.
+	void OnTrainingComplete(FSRTrainingJobRef InJob);
+	void OnTrainingStop(FSRTrainingJobRef InJob);
+	void OnSweepJobFinished(FSRTrainingJobRef InJob);
 
+	/*
+	* Stops training of current profile. Sweep is stopped as a whole and doesn't change the profile (bShouldSaveResult is ignored).
+	*/
 	void CancelTrainingTask(bool bShouldSaveResult = false);
+	void StopTrainingJob(const FSRTrainingJobRef& InJob, bool bShouldSaveResult = false);
+	//progress of current profile's training.
 	float GetSymbolTrainingProgress() const;
 	int32 GetSymbolTrainingEpochs() const;
 	void GetSymbolTrainingScores(TArray<float>& OutScoresPerSymbol, float& OutGlobalScore) const;
+	FSRTrainingStats GetSymbolTrainingStats() const;
+	/*
+	* true stops all trainings without saving.
+	*/
 	void SetShouldStopTraining(bool InValue);
+	FORCEINLINE const FSRTrainingScheduler& GetTrainingScheduler() const { return TrainingScheduler; }
 
 	void SRSaveConfig();
 	void SRLoadConfig();
@@ -298,11 +504,44 @@ private:
 	bool bRelativePathsChanged = false;
 	UPROPERTY(config)
 	FString LastRelativePath = "";
-	bool bIsTraining = false;
+	FSRTrainingScheduler TrainingScheduler;
+	TArray<FSRHyperparameterSweepRef> Sweeps;
 	UPROPERTY(config)
 	bool bIsLoaded = false;
 	UPROPERTY()
 	mutable class USymbolRecognizer* SymbolRecognizer;
 
+	TSharedPtr<FSRTrainingJob, ESPMode::ThreadSafe> GetCurrentTrainingJob() const;
+	/*
+	* Collects training data and settings of current profile.
+	*/
+	FSRTrainingJobRef MakeTrainingJob();
+	//job with InProfile's settings (e.g. a sweep candidate) training on already collected images.
+	FSRTrainingJobRef MakeTrainingJob(const FSRProfileData& InProfile, const FSRTrainingSetsRef& InTrainingSets);
+	/*
+	* Decodes network inputs of all images of current profile.
+	*/
+	FSRTrainingSetsRef CollectTrainingSets();
+	/*
+	* Hash of contents of current profile's image files (saved strokes with StrokeDirections encoding), files are not decoded.
+	*/
+	uint32 ComputeImagesHash();
+	/*
+	* Hash identifying trained network: InImagesHash combined with InProfile's params and revision of its shared trunk.
+	* Stored with the network, so training is skipped from the editor and SRTrain commandlet alike while it doesn't change.
+	*/
+	uint32 ComputeTrainingHash(const FSRProfileData& InProfile, uint32 InImagesHash) const;
+	void EnqueueTrainingJob(const FSRTrainingJobRef& InJob);
+	/*
+	* Selects profile in the tool and in USymbolRecognizer without refreshing UI.
+	* Used to collect data and save results of trainings of not selected profiles.
+	*/
+	void SwitchProfileForTraining(int32 InProfileIdx);
+	//game thread, saves InJob's result and lets scheduler start next jobs.
+	void FinishTrainingJob(const FSRTrainingJobRef& InJob);
+	//game thread, saves network of InJob to its profile (skipped when profile doesn't exist anymore).
+	void SaveTrainingJobResult(const FSRTrainingJobRef& InJob);
+	//game thread, saves the best network when InJob was the last candidate of its sweep.
+	void FinishSweepJob(const FSRTrainingJobRef& InJob);
 };
 
@@ -0,0 +1,29 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#pragma once
+#include "Commandlets/Commandlet.h"
+#include "SRTrainCommandlet.generated.h"
+
+/*
+ * Trains profiles without the editor UI, e.g. on a build machine:
+ * UE4Editor-Cmd <Project> -run=SRTrain [-profile=Name] [-threads=N] [-noresume] [-force] [-sweep] [-maxepochs=N] [-timeout=Seconds] -nullrhi
+ * Trained networks are saved to USymbolRecognizerData the same way as from the editor.
+ * Profiles already trained on the same images and params are skipped (shared with the editor), -force trains them anyway.
+ * -sweep runs USRToolManager::StartSweep instead and saves params it picked to the editor config.
+ * Auto trainings are stopped after -maxepochs epochs and all trainings after -timeout seconds (checkpoints are kept),
+ * so a profile that can't reach its accuracy doesn't block the machine.
+ * Returns 1 when any profile couldn't be trained or didn't reach its AcceptableTrainingAccuracy.
+ */
+UCLASS()
+class SYMBOLRECOGNIZERPLUGINEDITOR_API USRTrainCommandlet : public UCommandlet
+{
+	GENERATED_UCLASS_BODY()
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	//seconds between progress logs.
+	static constexpr double ProgressLogInterval = 30.0;
+	//defaults of -maxepochs and -timeout, 0 disables the limit.
+	static constexpr int32 DefaultMaxEpochs = 10000;
+	static constexpr double DefaultTimeoutSeconds = 6.0 * 60.0 * 60.0;
+};
@@ -0,0 +1,47 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#pragma once
+#include "SRNeuralNetwork.h"
+#include "SRTrainingCheckpoint.generated.h"
+
+/*
+ * State of unfinished training, enough to continue it after cancel or editor restart.
+ * Training uses plain SGD, so weights, epochs and sampler state are the whole optimizer state.
+ */
+USTRUCT(NotBlueprintable)
+struct SYMBOLRECOGNIZERPLUGINEDITOR_API FSRTrainingCheckpoint
+{
+	GENERATED_BODY()
+
+	static const int32 Version = 1;
+
+	UPROPERTY()
+	FString ProfileName;
+	/*
+	* Hash of network layout, training settings and training images. Checkpoint with other hash can't be resumed.
+	*/
+	UPROPERTY()
+	uint32 ParamsHash = 0;
+	UPROPERTY()
+	int32 Epochs = 0;
+	UPROPERTY()
+	FSRNeuralNetwork Network;
+	UPROPERTY()
+	FSRNeuralNetwork CascadeNetwork;
+	UPROPERTY()
+	int32 SamplerSeed = 0;
+	UPROPERTY()
+	TArray<uint8> SamplesHardness;
+	UPROPERTY()
+	TArray<float> SymbolsScores;
+
+	/*
+	* Saved/Checkpoints directory of the plugin.
+	*/
+	static FString GetPath(const FString& InProfileName);
+	/*
+	* Written to a temporary file first and moved over the old checkpoint, so interrupted write never leaves broken file.
+	*/
+	bool Save() const;
+	static bool Load(const FString& InProfileName, FSRTrainingCheckpoint& OutCheckpoint);
+	static void Delete(const FString& InProfileName);
+};
@@ -0,0 +1,144 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#pragma once
+#include "SRNetworkTrainingAsyncTask.h"
+#include "SRTrainingCheckpoint.h"
+#include "SRNetworkMailbox.h"
+
+//decoded training images, shared by jobs of one sweep.
+typedef TSharedRef<const TArray<FSRTrainingDataSet>, ESPMode::ThreadSafe> FSRTrainingSetsRef;
+
+enum class ESRTrainingJobState : uint8
+{
+	Queued,
+	Running,
+	Completed,
+	Stopped
+};
+
+/*
+ * Single training of one profile. Owns its settings, result networks, progress and stop flag,
+ * so trainings of many profiles can run at the same time.
+ */
+class SYMBOLRECOGNIZERPLUGINEDITOR_API FSRTrainingJob
+{
+public:
+	FString ProfileName;
+	//shown next to ProfileName when set, e.g. configuration of a sweep candidate.
+	FString Label;
+
+	//settings, not changed after the job is started.
+	FSRTrainingSetsRef TrainingSets = MakeShared<const TArray<FSRTrainingDataSet>, ESPMode::ThreadSafe>();
+	int32 SymbolsCount = 0;
+	int32 ImagesCount = 0;
+	uint32 HiddenNodes = 0;
+	int32 EpochsLimit = 0;// if <= 0 then autotraining until Accuracy is reached
+	float AcceptableAccuracy = 0.95f;
+	float DeltaBestAnswers = 0.9f;
+	bool bUseCascade = false;
+	uint32 CascadeHiddenNodes = 0;
+	//Network.wih is a shared trunk, only who is trained.
+	bool bTrainOutputLayerOnly = false;
+	//fraction of hidden nodes removed from PrunedNetwork, 0 = no pruned network.
+	float PrunedHiddenRatio = 0.0f;
+	ESRTrainingParallelism Parallelism = ESRTrainingParallelism::SingleThread;
+	int32 ThreadsCount = 1;
+	int32 BatchSize = 32;
+	ESRSamplingMode SamplingMode = ESRSamplingMode::Sequential;
+	int32 RandomSeed = 0;
+	int32 EvaluationInterval = 1;
+	float EvaluationSampleRatio = 1.0f;
+	//epochs between checkpoints, 0 = no checkpoints.
+	int32 CheckpointInterval = 0;
+	FSRAugmentationSettings Augmentation;
+	uint32 ParamsHash = 0;
+	//images and params hash saved with the network (see USRToolManager::ComputeTrainingHash), 0 = not saved.
+	uint32 TrainingHash = 0;
+	//valid when training continues from checkpoint.
+	TSharedPtr<const FSRTrainingCheckpoint, ESPMode::ThreadSafe> ResumeCheckpoint;
+
+	//results, written only by the worker thread while job is running.
+	FSRNeuralNetwork Network;
+	FSRNeuralNetwork CascadeNetwork;
+	//pruned and fine-tuned copy of the final Network (see USymbolRecognizer::MakePrunedNetwork).
+	FSRNeuralNetwork PrunedNetwork;
+	float PrunedAgreementRate = -1.0f;
+	//evaluated snapshots and the final network for live testing (USymbolRecognizer::SetNetworkMailbox).
+	TSharedRef<FSRNetworkMailbox, ESPMode::ThreadSafe> Mailbox = MakeShared<FSRNetworkMailbox, ESPMode::ThreadSafe>();
+
+	//called on the worker thread.
+	FTrainingTaskCompleteDelegate OnComplete;
+	FTrainingTaskStopDelegate OnStop;
+
+	/*
+	* Continues training from InCheckpoint instead of new weights.
+	*/
+	void ResumeFrom(const FSRTrainingCheckpoint& InCheckpoint);
+	/*
+	* All training images in one list (used to calibrate int8 and pruned networks).
+	*/
+	void CollectCalibrationInputs(TArray<TArray<float>>& OutInputs) const;
+
+	FORCEINLINE FString GetDisplayName() const { return Label.IsEmpty() ? ProfileName : ProfileName + " [" + Label + "]"; }
+	ESRTrainingJobState GetState() const;
+	void SetState(ESRTrainingJobState InState);
+	bool IsActive() const;
+
+	void RequestStop(bool bInSaveResult);
+	FORCEINLINE bool IsStopRequested() const { return bStopRequested; }
+	FORCEINLINE bool ShouldSaveOnStop() const { return bSaveOnStop; }
+
+	void ReportProgress(float InProgress, int32 InEpochs, const TArray<float>& InScores);
+	/*
+	* Copy of the last reported progress, safe to call while job is running.
+	*/
+	void GetProgress(float& OutProgress, int32& OutEpochs, TArray<float>& OutScores) const;
+	void SetStats(const FSRTrainingStats& InStats);
+	FSRTrainingStats GetStats() const;
+	FORCEINLINE int32 GetCoresCost() const { return Parallelism == ESRTrainingParallelism::SingleThread ? 1 : ThreadsCount; }
+
+private:
+	FThreadSafeBool bStopRequested = false;
+	FThreadSafeBool bSaveOnStop = false;
+
+	mutable FCriticalSection StatusLock;
+	ESRTrainingJobState State = ESRTrainingJobState::Queued;
+	float Progress = 0.0f;
+	int32 Epochs = 0;
+	TArray<float> Scores;
+	FSRTrainingStats Stats;
+};
+
+typedef TSharedRef<FSRTrainingJob, ESPMode::ThreadSafe> FSRTrainingJobRef;
+
+/*
+ * Queue of training jobs. Starts queued jobs as long as their cores fit into CoresBudget (one job always runs).
+ * Game thread only.
+ */
+class SYMBOLRECOGNIZERPLUGINEDITOR_API FSRTrainingScheduler
+{
+public:
+	//0 means all threads of the training pool.
+	int32 CoresBudget = 0;
+
+	void Enqueue(const FSRTrainingJobRef& InJob);
+	/*
+	* Queued job is removed at once, running one stops after current sample (its OnStop is called).
+	*/
+	void Stop(const FSRTrainingJobRef& InJob, bool bInSaveResult);
+	void StopAll(bool bInSaveResult);
+	/*
+	* Must be called when job's result was handled, so next jobs can start.
+	*/
+	void OnJobFinished(const FSRTrainingJobRef& InJob);
+
+	FORCEINLINE const TArray<FSRTrainingJobRef>& GetJobs() const { return Jobs; }
+	TSharedPtr<FSRTrainingJob, ESPMode::ThreadSafe> FindActiveJob(const FString& InProfileName) const;
+	bool HasActiveJobs() const;
+
+private:
+	//active jobs in order of queueing.
+	TArray<FSRTrainingJobRef> Jobs;
+
+	int32 GetCoresBudget() const;
+	void StartQueuedJobs();
+};
@@ -0,0 +1,89 @@
+// Copyright 2019 Piotr Macharzewski. All Rights Reserved.
+#pragma once
+#include "CoreMinimal.h"
+#include "Misc/QueuedThreadPool.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Templates/Function.h"
+#include "SRTrainingThreadPool.generated.h"
+
+UENUM(NotBlueprintable)
+enum class ESRTrainingThreadPriority : uint8
+{
+	Lowest = 0,
+	BelowNormal,
+	Normal
+};
+
+/*
+ * Worker threads owned by the plugin. Trainings and their parallel loops run here instead of GThreadPool and the task graph,
+ * so shader compilation, asset loading and PIE keep their threads and trainings get predictable throughput.
+ */
+class SYMBOLRECOGNIZERPLUGINEDITOR_API FSRTrainingThreadPool : public FQueuedThreadPool
+{
+public:
+	static FSRTrainingThreadPool& Get();
+	//called on module shutdown, waits for running work.
+	static void Shutdown();
+
+	virtual ~FSRTrainingThreadPool();
+
+	/*
+	* Recreates threads when settings differ from current ones. Fails when work is queued or running.
+	* @ InThreadsCount 0 means all logical cores but one.
+	* @ InAffinityMask bit per logical core, 0 means any core.
+	*/
+	bool Configure(int32 InThreadsCount, ESRTrainingThreadPriority InPriority, uint64 InAffinityMask);
+	bool IsBusy() const;
+
+	/*
+	* Runs InBody for indices [0, InNum). Calling thread takes part and helpers which didn't start before it's done are retracted,
+	* so calls from pool threads never wait on queued work.
+	* @ InMaxThreads limits threads running InBody at once (calling thread included), 0 means no limit.
+	*/
+	void ParallelFor(int32 InNum, TFunctionRef<void(int32)> InBody, int32 InMaxThreads = 0);
+
+	void SetPaused(bool bInPaused);
+	FORCEINLINE bool IsPaused() const { return bPaused; }
+	/*
+	* Blocks calling training while pool is paused.
+	* @ InShouldStop polled while waiting, so stop requests are not delayed by the pause.
+	*/
+	void WaitWhilePaused(TFunctionRef<bool()> InShouldStop) const;
+	//wall time spent paused since pool creation.
+	double GetPausedSeconds() const;
+
+	void SetPauseDuringPIE(bool bInPause);
+	void SetPlayingInEditor(bool bInPlaying);
+
+	//FQueuedThreadPool
+	virtual bool Create(uint32 InNumQueuedThreads, uint32 InStackSize = (128 * 1024), EThreadPriority InThreadPriority = TPri_BelowNormal) override;
+	virtual void Destroy() override;
+	virtual void AddQueuedWork(IQueuedWork* InQueuedWork) override;
+	virtual bool RetractQueuedWork(IQueuedWork* InQueuedWork) override;
+	virtual int32 GetNumThreads() const override;
+
+private:
+	class FWorker;
+
+	static TUniquePtr<FSRTrainingThreadPool> Instance;
+
+	TArray<FWorker*> Workers;
+	TArray<FWorker*> IdleWorkers;
+	//in order of queueing.
+	TArray<IQueuedWork*> QueuedWork;
+	mutable FCriticalSection QueueLock;
+	bool bDestroying = false;
+
+	EThreadPriority ThreadPriority = TPri_BelowNormal;
+	uint64 AffinityMask = 0;
+
+	FThreadSafeBool bPaused = false;
+	mutable FCriticalSection PauseLock;
+	double PauseStartTime = 0.0;
+	double PausedSeconds = 0.0;
+	bool bPauseDuringPIE = true;
+	bool bPlayingInEditor = false;
+
+	//called by worker when its work is done, @ return next work or nullptr when worker became idle.
+	IQueuedWork* ReturnToPoolOrGetNextJob(FWorker* InWorker);
+};
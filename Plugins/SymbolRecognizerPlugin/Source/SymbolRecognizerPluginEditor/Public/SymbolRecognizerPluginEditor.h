@@ -26,10 +26,14 @@ private:
 	void AddMenuExtension(FMenuBuilder& Builder);
 
 	TSharedRef<class SDockTab> OnSpawnPluginTab(const class FSpawnTabArgs& SpawnTabArgs);
+	//pauses trainings when set in USRToolManager::bPauseTrainingDuringPIE.
+	void OnPIEChanged(const bool bIsSimulating, bool bInPlaying);
 
 private:
 	static const FString SRDirectoryToAlwaysCook;
 	TSharedPtr<class FUICommandList> PluginCommands;
+	FDelegateHandle BeginPIEHandle;
+	FDelegateHandle EndPIEHandle;
 	void CleanupOnClosed();
 	UPROPERTY()
 	class USRToolManager* SRToolManager;